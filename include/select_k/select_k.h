@@ -50,7 +50,41 @@
 #include <vector>
 #include <queue>
 #include <stack>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
 namespace k {
+
+/**
+ * Codec that serializes into / deserializes from an in-memory byte buffer.
+ * 
+ * Any codec passed to Select::serialize()/deserialize() needs write(const void*, size_t) and bool read(void*, size_t).
+ * Candidates or scores that are not trivially copyable additionally need encode(const X&) / bool decode(X&) overloads.
+ */
+class BufferCodec {
+public:
+    BufferCodec() = default;
+    explicit BufferCodec(std::vector<uint8_t> bytes) : bytes_(std::move(bytes)) {}
+
+    void write(const void* data, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        bytes_.insert(bytes_.end(), p, p + size);
+    }
+
+    bool read(void* data, size_t size) {
+        if (size > bytes_.size() - offset_) { return false; }
+        std::memcpy(data, bytes_.data() + offset_, size);
+        offset_ += size;
+        return true;
+    }
+
+    const std::vector<uint8_t>& bytes() const { return bytes_; }
+    void rewind() { offset_ = 0; }
+private:
+    std::vector<uint8_t> bytes_;
+    size_t offset_ = 0;
+};
+
 template <
     typename T, 
     typename ScoreType,
@@ -72,27 +106,67 @@ public:
         }
     };
 
-    using Heap = std::priority_queue<ScoredCandidate, Container, ScoredCompare>;
+    // priority_queue that also exposes its underlying container (already in heap order)
+    class Heap : public std::priority_queue<ScoredCandidate, Container, ScoredCompare> {
+    public:
+        using std::priority_queue<ScoredCandidate, Container, ScoredCompare>::priority_queue;
+        Container& container() { return this->c; }
+        const Container& container() const { return this->c; }
+    };
+
+    // serialized state header : magic "SELK", format version, k, stored count, fixed sizes (0 if codec encoded)
+    static constexpr uint32_t kSerialMagic = 0x4b4c4553;
+    static constexpr uint32_t kSerialVersion = 1;
+    static constexpr bool kBulkSerializable = std::is_trivially_copyable_v<Candidate> && std::is_trivially_copyable_v<Score>;
+    // entries read (and allocated) at a time by deserialize()
+    static constexpr size_t kDeserializeChunk = 4096;
     
     Select(size_t k, ScoringFunction scorer) : k_(k), scorer_(scorer) {}
     
     ~Select() = default;
 
+    size_t k() const { return k_; }
+    size_t size() const { return selected_.size(); }
+    const ScoringFunction& scorer() const { return scorer_; }
+
+    // drops the current selection (k and the scoring function are kept)
+    void clear() {
+        selected_.container().clear();
+    }
+
     bool offer(const Candidate& candidate) {
         if (k_ == 0) { return false; }
-        ScoreType score = scorer_(candidate);
-        ScoredCandidate scored { candidate, score};
-        if (selected_.size() < k_) {
-            selected_.push({candidate, score});
-            return true;
-        }
-        const auto& worst = selected_.top();
-        if (scoredCompare_(scored, worst)) {
+        return offerScored(candidate, scorer_(candidate));
+    }
+
+    // offer a candidate whose score is already known (the scoring function is not called)
+    // the candidate is only copied into the selection if it is admitted
+    bool offerScored(const Candidate& candidate, const Score& score) {
+        if (!admits(score)) { return false; }
+        if (selected_.size() == k_) {
             selected_.pop();
-            selected_.push(scored);
-            return true;
         }
-        return false;
+        selected_.push({candidate, score});
+        return true;
+    }
+
+    // true once k candidates are selected (from then on a candidate has to beat threshold() to get in)
+    bool full() const { return selected_.size() >= k_; }
+
+    // score of the worst selected candidate (only valid if size() > 0)
+    const Score& threshold() const { return selected_.top().second; }
+
+    // true if a candidate with this score would currently make it into the selection
+    bool admits(const Score& score) const {
+        if (selected_.size() < k_) { return k_ != 0; }
+        return scoredCompare_.compare(score, selected_.top().second);
+    }
+
+    // offer all the selected candidates of another selector (with their stored scores, no rescoring)
+    void merge(const Select& other) {
+        for (const auto& entry : other.selected_.container()) {
+            offerScored(entry.first, entry.second);
+        }
     }
 
     template <typename OutputIterator>
@@ -113,6 +187,109 @@ public:
         }
     }
 
+    // like results() but emits ScoredCandidate (candidate, score) pairs, best first if sorted. The selection is kept.
+    template <typename OutputIterator>
+    size_t scoredResults(OutputIterator out, bool sorted) const {
+        Container entries = selected_.container();
+        if (sorted) {
+            std::sort_heap(entries.begin(), entries.end(), scoredCompare_);
+        }
+        for (auto& entry : entries) {
+            *out++ = std::move(entry);
+        }
+        return entries.size();
+    }
+
+    /**
+     * Writes k, the stored scores and candidates to the codec. 
+     * Entries are written in heap order so that deserialize() does not have to re-heapify or rescore.
+     * Trivially copyable Candidate and Score types are written with a single bulk write.
+     */
+    template <typename Codec>
+    void serialize(Codec& codec) const {
+        const Container& entries = selected_.container();
+        uint32_t header[2] = { kSerialMagic, kSerialVersion };
+        uint64_t counts[2] = { k_, entries.size() };
+        uint32_t sizes[2] = { 0, 0 };
+        if constexpr (kBulkSerializable) {
+            sizes[0] = sizeof(Candidate);
+            sizes[1] = sizeof(Score);
+        }
+        codec.write(header, sizeof(header));
+        codec.write(counts, sizeof(counts));
+        codec.write(sizes, sizeof(sizes));
+        if constexpr (kBulkSerializable) {
+            std::vector<uint8_t> bytes(entries.size() * (sizeof(Candidate) + sizeof(Score)));
+            uint8_t* p = bytes.data();
+            for (const auto& entry : entries) {
+                std::memcpy(p, &entry.first, sizeof(Candidate));
+                p += sizeof(Candidate);
+                std::memcpy(p, &entry.second, sizeof(Score));
+                p += sizeof(Score);
+            }
+            codec.write(bytes.data(), bytes.size());
+        } else {
+            for (const auto& entry : entries) {
+                codec.encode(entry.first);
+                codec.encode(entry.second);
+            }
+        }
+    }
+
+    /**
+     * Replaces the current state (k and stored candidates) with the one read from the codec in O(K).
+     * The scoring function is kept as is. Returns false (leaving the selector untouched) if the
+     * stream was not written by serialize() for the same Candidate / Score layout, or its entries are
+     * not in heap order for this selector's comparator (e.g. a k::Top checkpoint read by a k::Bottom).
+     */
+    template <typename Codec>
+    bool deserialize(Codec& codec) {
+        uint32_t header[2] = { 0, 0 };
+        uint64_t counts[2] = { 0, 0 };
+        uint32_t sizes[2] = { 0, 0 };
+        if (!codec.read(header, sizeof(header)) || !codec.read(counts, sizeof(counts)) || !codec.read(sizes, sizeof(sizes))) {
+            return false;
+        }
+        if (header[0] != kSerialMagic || header[1] != kSerialVersion || counts[1] > counts[0]) {
+            return false;
+        }
+        // counts come from the stream : entries grow as they are read, so a corrupt count fails on a short read
+        // instead of allocating up front
+        Container entries;
+        entries.reserve(std::min<uint64_t>(counts[1], kDeserializeChunk));
+        if constexpr (kBulkSerializable) {
+            if (sizes[0] != sizeof(Candidate) || sizes[1] != sizeof(Score)) { return false; }
+            std::vector<uint8_t> bytes;
+            for (uint64_t remaining = counts[1]; remaining > 0;) {
+                const size_t chunk = static_cast<size_t>(std::min<uint64_t>(remaining, kDeserializeChunk));
+                bytes.resize(chunk * (sizeof(Candidate) + sizeof(Score)));
+                if (!codec.read(bytes.data(), bytes.size())) { return false; }
+                const uint8_t* p = bytes.data();
+                for (size_t i = 0; i < chunk; ++i) {
+                    ScoredCandidate entry;
+                    std::memcpy(&entry.first, p, sizeof(Candidate));
+                    p += sizeof(Candidate);
+                    std::memcpy(&entry.second, p, sizeof(Score));
+                    p += sizeof(Score);
+                    entries.push_back(entry);
+                }
+                remaining -= chunk;
+            }
+        } else {
+            if (sizes[0] != 0 || sizes[1] != 0) { return false; }
+            for (uint64_t i = 0; i < counts[1]; ++i) {
+                ScoredCandidate entry;
+                if (!codec.decode(entry.first) || !codec.decode(entry.second)) { return false; }
+                entries.push_back(std::move(entry));
+            }
+        }
+        // checked, not rebuilt : is_heap is O(K) and a wrong order means the stream is not ours
+        if (!std::is_heap(entries.begin(), entries.end(), scoredCompare_)) { return false; }
+        k_ = counts[0];
+        selected_.container() = std::move(entries);
+        return true;
+    }
+
 protected:
     
     template <typename OutputIterator>
@@ -159,10 +336,39 @@ public:
     bool offer(const T& t) {
         return select_.offer(t);
     }
+    bool offerScored(const T& t, const ScoreType& score) {
+        return select_.offerScored(t, score);
+    }
+    bool admits(const ScoreType& score) const {
+        return select_.admits(score);
+    }
+    bool full() const { return select_.full(); }
+    const ScoreType& threshold() const { return select_.threshold(); }
+    void merge(const Top& other) {
+        select_.merge(other.select_);
+    }
     template <typename OutputIterator>
     size_t results(OutputIterator out, bool sorted, bool preserveSelection = false) {
         return select_.results(out, sorted, preserveSelection);
     }
+    template <typename OutputIterator>
+    size_t scoredResults(OutputIterator out, bool sorted) const {
+        return select_.scoredResults(out, sorted);
+    }
+    size_t k() const { return select_.k(); }
+    size_t size() const { return select_.size(); }
+    const ScoringFunction& scorer() const { return select_.scorer(); }
+    void clear() {
+        select_.clear();
+    }
+    template <typename Codec>
+    void serialize(Codec& codec) const {
+        select_.serialize(codec);
+    }
+    template <typename Codec>
+    bool deserialize(Codec& codec) {
+        return select_.deserialize(codec);
+    }
 
 
     template <typename OutputIterator, typename InputIterator>
@@ -189,10 +395,39 @@ public:
     bool offer(const T& t) {
         return select_.offer(t);
     }
+    bool offerScored(const T& t, const ScoreType& score) {
+        return select_.offerScored(t, score);
+    }
+    bool admits(const ScoreType& score) const {
+        return select_.admits(score);
+    }
+    bool full() const { return select_.full(); }
+    const ScoreType& threshold() const { return select_.threshold(); }
+    void merge(const Bottom& other) {
+        select_.merge(other.select_);
+    }
     template <typename OutputIterator>
     size_t results(OutputIterator out, bool sorted, bool preserveSelection = false) {
         return select_.results(out, sorted, preserveSelection);
     }
+    template <typename OutputIterator>
+    size_t scoredResults(OutputIterator out, bool sorted) const {
+        return select_.scoredResults(out, sorted);
+    }
+    size_t k() const { return select_.k(); }
+    size_t size() const { return select_.size(); }
+    const ScoringFunction& scorer() const { return select_.scorer(); }
+    void clear() {
+        select_.clear();
+    }
+    template <typename Codec>
+    void serialize(Codec& codec) const {
+        select_.serialize(codec);
+    }
+    template <typename Codec>
+    bool deserialize(Codec& codec) {
+        return select_.deserialize(codec);
+    }
 
 
     template <typename OutputIterator, typename InputIterator>
@@ -0,0 +1,74 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : file descriptor codec for Select::serialize() / deserialize() and the index save / load routines
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      k::FdCodec codec(fd);                   // a pipe, socket or file opened by the caller (not closed here)
+ *      selector.serialize(codec);
+ *      ...
+ *      restored.deserialize(codec);
+ *
+ *  Same interface as k::BufferCodec (select_k.h) : write() retries short writes and throws std::system_error,
+ *  read() retries short reads and returns false on error or end of file.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <cerrno>
+#include <system_error>
+#include <unistd.h>
+namespace k {
+
+// codec over a file descriptor (a pipe, socket or file), write() throws std::system_error on failure
+class FdCodec {
+public:
+    explicit FdCodec(int fd) : fd_(fd) {}
+
+    void write(const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t n = ::write(fd_, p, size);
+            if (n < 0) {
+                if (errno == EINTR) { continue; }
+                throw std::system_error(errno, std::generic_category(), "write");
+            }
+            p += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+
+    bool read(void* data, size_t size) {
+        char* p = static_cast<char*>(data);
+        while (size > 0) {
+            ssize_t n = ::read(fd_, p, size);
+            if (n < 0 && errno == EINTR) { continue; }
+            if (n <= 0) { return false; }
+            p += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+private:
+    int fd_;
+};
+
+}
@@ -0,0 +1,124 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : top-k over a score column (contiguous scores + optional validity bitmap + optional row ids)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      std::vector<size_t> rows;
+ *      k::TopColumn<double>::compute(std::back_inserter(rows), k, std::span<const double>(scores), validity);
+ *
+ *  The validity bitmap is Arrow style : bit (i % 64) of word (i / 64) set means row i is not null. Rows past the
+ *  end of a (non empty) bitmap that is shorter than the column are treated as null.
+ *  Rows are processed 64 at a time : a block whose validity word is 0 is skipped with one test, the other
+ *  blocks are compared against the current K-th best score with a branch-free (vectorizable) loop that
+ *  yields a 64 bit mask, and only rows set in (mask & validity) are offered to the selector.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include <span>
+namespace k {
+
+template <typename ScoreType, class CompareType>
+class SelectColumn {
+public:
+    using Score = ScoreType;
+    using Compare = CompareType;
+    using Selector = Select<size_t, Score, Compare>;
+
+    static constexpr size_t kBlock = 64;
+
+    // row indices (positions in scores) of the K best non-null scores, best first
+    template <typename OutputIterator>
+    static size_t compute(OutputIterator out, size_t k, std::span<const Score> scores, std::span<const uint64_t> validity = {}) {
+        Selector selector = select(k, scores, validity);
+        return selector.results(out, true, false);
+    }
+
+    // row ids of the K best non-null scores, best first
+    template <typename OutputIterator, typename RowId>
+    static size_t compute(OutputIterator out, size_t k, std::span<const Score> scores, std::span<const RowId> rowIds,
+                          std::span<const uint64_t> validity = {}) {
+        Selector selector = select(k, scores, validity);
+        std::vector<size_t> rows;
+        rows.reserve(selector.size());
+        selector.results(std::back_inserter(rows), true, false);
+        for (size_t row : rows) {
+            *out++ = rowIds[row];
+        }
+        return rows.size();
+    }
+
+    // the selector (row index, score) over the column
+    static Selector select(size_t k, std::span<const Score> scores, std::span<const uint64_t> validity = {}) {
+        Selector selector(k, [scores](const size_t& row) { return scores[row]; });
+        size_t count = k == 0 ? 0 : scores.size();
+        if (!validity.empty()) {
+            // rows with no validity word are null
+            count = std::min(count, validity.size() * kBlock);
+        }
+        for (size_t first = 0; first < count; first += kBlock) {
+            const size_t rows = std::min(kBlock, count - first);
+            uint64_t valid = rows == kBlock ? ~uint64_t(0) : (uint64_t(1) << rows) - 1;
+            if (!validity.empty()) {
+                valid &= validity[first / kBlock];
+                if (valid == 0) { continue; }
+            }
+            const Score* block = scores.data() + first;
+            uint64_t candidates = valid;
+            if (selector.full() && rows == kBlock) {
+                candidates &= beats(block, selector.threshold());
+            }
+            while (candidates != 0) {
+                size_t row = static_cast<size_t>(__builtin_ctzll(candidates));
+                candidates &= candidates - 1;
+                selector.offerScored(first + row, block[row]);
+            }
+        }
+        return selector;
+    }
+
+private:
+    // bit i set if block[i] is better than threshold (branch free so the compiler can vectorize it)
+    static uint64_t beats(const Score* block, Score threshold) {
+        Compare compare;
+        uint8_t flags[kBlock];
+        for (size_t i = 0; i < kBlock; ++i) {
+            flags[i] = compare(block[i], threshold) ? 1 : 0;
+        }
+        uint64_t mask = 0;
+        for (size_t i = 0; i < kBlock; i += 8) {
+            uint64_t bytes;
+            std::memcpy(&bytes, flags + i, sizeof(bytes));
+            // gather the low bit of each of the 8 bytes into 8 consecutive bits
+            mask |= ((bytes * 0x0102040810204080ull) >> 56) << i;
+        }
+        return mask;
+    }
+};
+
+template <typename ScoreType>
+using TopColumn = SelectColumn<ScoreType, std::greater<ScoreType>>;
+
+template <typename ScoreType>
+using BottomColumn = SelectColumn<ScoreType, std::less<ScoreType>>;
+
+}
@@ -0,0 +1,266 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : memory-mapped vector dataset files - page aligned rows, queried in place with no load step (POSIX)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      k::DatasetWriter writer("base.vec", dim, k::Dtype::Float32, k::kDatasetNorms | k::kDatasetIds);
+ *      for (...) {
+ *          writer.append(row, id);             // streamed to disk, only norms and ids are held until finish()
+ *      }
+ *      writer.finish();
+ *
+ *      k::Dataset base("base.vec");            // mmap + header check, no rows are read
+ *      k::Nearest nearest(base.vectors(), base.count(), base.dim(), k::Metric::Cosine, false, base.norms());
+ *      nearest.search(std::back_inserter(neighbors), query, 10);
+ *      base.id(neighbors[0].first);            // the external id of a row
+ *
+ *  Layout (little endian, every section starts on a 4096 byte boundary) :
+ *
+ *      [0, 4096)       header : magic "SKVD", version, dtype, flags, count, dim, section offsets
+ *      vectors         count x dim values (float32 or IEEE fp16), rows back to back
+ *      norms           count float32 L2 row norms                     (kDatasetNorms)
+ *      ids             count uint64 external ids                      (kDatasetIds)
+ *
+ *  Opening a dataset maps the file and validates the header - rows are paged in by the kernel the first time a
+ *  search touches them. The mapping is advised MADV_RANDOM (for index lookups); prefetch() / advise() take hints
+ *  for a row range, e.g. MADV_WILLNEED ahead of a sequential scan. The writer keeps rows out of memory : it
+ *  buffers them into large writes, then appends the norm / id sections and rewrites the header in finish().
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k_mmap.h"
+#include "select_k/select_k_codec.h"
+#include "select_k/select_k_simd.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+namespace k {
+
+enum class Dtype : uint32_t {
+    Float32 = 0,
+    Float16 = 1,            // IEEE binary16, see simd::toHalf()
+};
+
+// optional sections
+constexpr uint32_t kDatasetNorms = 1;
+constexpr uint32_t kDatasetIds = 2;
+
+struct DatasetHeader {
+    static constexpr uint32_t kMagic = 0x44564b53;      // "SKVD"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint64_t kAlignment = 4096;
+
+    uint32_t magic = kMagic;
+    uint32_t version = kVersion;
+    Dtype dtype = Dtype::Float32;
+    uint32_t flags = 0;
+    uint64_t count = 0;
+    uint64_t dim = 0;
+    uint64_t vectorsOffset = kAlignment;
+    uint64_t normsOffset = 0;       // 0 = no section
+    uint64_t idsOffset = 0;
+
+    static uint64_t align(uint64_t offset) { return (offset + kAlignment - 1) / kAlignment * kAlignment; }
+    static size_t valueSize(Dtype dtype) { return dtype == Dtype::Float16 ? 2 : 4; }
+    size_t rowBytes() const { return static_cast<size_t>(dim) * valueSize(dtype); }
+};
+
+class DatasetWriter {
+public:
+    // rows are written out as they are appended, throws std::system_error if path cannot be created
+    DatasetWriter(const std::string& path, size_t dim, Dtype dtype = Dtype::Float32, uint32_t flags = 0)
+        : path_(path) {
+        header_.dtype = dtype;
+        header_.flags = flags & (kDatasetNorms | kDatasetIds);
+        header_.dim = dim;
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        // the header page is rewritten by finish()
+        buffer_.assign(DatasetHeader::kAlignment, 0);
+    }
+
+    DatasetWriter(const DatasetWriter&) = delete;
+    DatasetWriter& operator=(const DatasetWriter&) = delete;
+
+    // finishes the file if finish() was not called (errors are lost - call finish() to see them)
+    ~DatasetWriter() {
+        if (fd_ < 0) { return; }
+        try {
+            finish();
+        } catch (const std::system_error&) {
+            if (fd_ >= 0) { ::close(fd_); }
+        }
+    }
+
+    size_t count() const { return static_cast<size_t>(header_.count); }
+
+    // appends one row of dim floats (converted to the file's dtype), id is kept if the file has ids
+    void append(const float* row, uint64_t id = 0) {
+        const size_t offset = buffer_.size();
+        buffer_.resize(offset + header_.rowBytes());
+        if (header_.dtype == Dtype::Float16) {
+            simd::toHalf(row, reinterpret_cast<uint16_t*>(buffer_.data() + offset), header_.dim);
+        } else {
+            std::memcpy(buffer_.data() + offset, row, header_.rowBytes());
+        }
+        if (header_.flags & kDatasetNorms) {
+            norms_.push_back(std::sqrt(simd::dot(row, row, header_.dim)));
+        }
+        if (header_.flags & kDatasetIds) {
+            ids_.push_back(id);
+        }
+        ++header_.count;
+        if (buffer_.size() >= kBufferSize) {
+            flush();
+        }
+    }
+
+    // writes the norm / id sections and the final header, then closes the file
+    void finish() {
+        if (fd_ < 0) { return; }
+        uint64_t offset = header_.vectorsOffset + header_.count * header_.rowBytes();
+        if (header_.flags & kDatasetNorms) {
+            offset = pad(offset);
+            header_.normsOffset = offset;
+            write(norms_.data(), norms_.size() * sizeof(float));
+            offset += norms_.size() * sizeof(float);
+        }
+        if (header_.flags & kDatasetIds) {
+            offset = pad(offset);
+            header_.idsOffset = offset;
+            write(ids_.data(), ids_.size() * sizeof(uint64_t));
+            offset += ids_.size() * sizeof(uint64_t);
+        }
+        flush();
+        if (::lseek(fd_, 0, SEEK_SET) != 0) {
+            throw std::system_error(errno, std::generic_category(), "lseek " + path_);
+        }
+        FdCodec codec(fd_);
+        codec.write(&header_, sizeof(header_));
+        if (::close(fd_) != 0) {
+            fd_ = -1;
+            throw std::system_error(errno, std::generic_category(), "close " + path_);
+        }
+        fd_ = -1;
+    }
+
+private:
+    // rows are written in chunks of at least this many bytes
+    static constexpr size_t kBufferSize = 1 << 22;
+
+    void write(const void* data, size_t size) {
+        if (size == 0) { return; }
+        const size_t offset = buffer_.size();
+        buffer_.resize(offset + size);
+        std::memcpy(buffer_.data() + offset, data, size);
+        if (buffer_.size() >= kBufferSize) {
+            flush();
+        }
+    }
+
+    // zero fill up to the next section boundary
+    uint64_t pad(uint64_t offset) {
+        buffer_.resize(buffer_.size() + (DatasetHeader::align(offset) - offset), 0);
+        return DatasetHeader::align(offset);
+    }
+
+    void flush() {
+        FdCodec codec(fd_);
+        codec.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    DatasetHeader header_;
+    std::vector<char> buffer_;
+    std::vector<float> norms_;
+    std::vector<uint64_t> ids_;
+};
+
+class Dataset {
+public:
+    /**
+     * maps a file written by DatasetWriter, throws std::system_error if it cannot be mapped, or
+     * (std::errc::invalid_argument) if it is not a dataset / is truncated
+     */
+    explicit Dataset(const std::string& path) : file_(path, false) {
+        if (file_.size() < sizeof(DatasetHeader)) {
+            throw std::system_error(std::make_error_code(std::errc::invalid_argument), "dataset " + path);
+        }
+        std::memcpy(&header_, file_.data(), sizeof(header_));
+        if (header_.magic != DatasetHeader::kMagic || header_.version != DatasetHeader::kVersion ||
+            (header_.dtype != Dtype::Float32 && header_.dtype != Dtype::Float16) ||
+            header_.dim == 0 || !fits(header_.vectorsOffset, header_.rowBytes()) ||
+            ((header_.flags & kDatasetNorms) && !fits(header_.normsOffset, sizeof(float))) ||
+            ((header_.flags & kDatasetIds) && !fits(header_.idsOffset, sizeof(uint64_t)))) {
+            throw std::system_error(std::make_error_code(std::errc::invalid_argument), "dataset " + path);
+        }
+        file_.advise(MADV_RANDOM);
+    }
+
+    size_t count() const { return static_cast<size_t>(header_.count); }
+    size_t dim() const { return static_cast<size_t>(header_.dim); }
+    Dtype dtype() const { return header_.dtype; }
+    const DatasetHeader& header() const { return header_; }
+
+    // the rows, count x dim (nullptr unless the dtype matches)
+    const float* vectors() const { return header_.dtype == Dtype::Float32 ? section<float>(header_.vectorsOffset) : nullptr; }
+    const uint16_t* halves() const { return header_.dtype == Dtype::Float16 ? section<uint16_t>(header_.vectorsOffset) : nullptr; }
+    const float* row(size_t index) const { return vectors() + index * dim(); }
+
+    // L2 row norms and external ids (nullptr if the file has none)
+    const float* norms() const { return header_.flags & kDatasetNorms ? section<float>(header_.normsOffset) : nullptr; }
+    const uint64_t* ids() const { return header_.flags & kDatasetIds ? section<uint64_t>(header_.idsOffset) : nullptr; }
+    // external id of a row (the row index itself if the file has no ids)
+    uint64_t id(size_t index) const { return header_.flags & kDatasetIds ? ids()[index] : index; }
+
+    // madvise() hint for rows [first, first + rows)
+    void advise(int advice, size_t first, size_t rows) const {
+        file_.advise(advice, header_.vectorsOffset + first * header_.rowBytes(), rows * header_.rowBytes());
+    }
+
+    // asks the kernel to start paging in rows [first, first + rows)
+    void prefetch(size_t first, size_t rows) const { advise(MADV_WILLNEED, first, rows); }
+
+private:
+    // whether a section of count elements of the given size at offset lies inside the file
+    bool fits(uint64_t offset, uint64_t elementBytes) const {
+        return offset % DatasetHeader::kAlignment == 0 && offset >= DatasetHeader::kAlignment && offset <= file_.size() &&
+               elementBytes <= file_.size() && header_.count <= (file_.size() - offset) / elementBytes;
+    }
+
+    template <typename T>
+    const T* section(uint64_t offset) const { return reinterpret_cast<const T*>(file_.data() + offset); }
+
+    MappedFile file_;
+    DatasetHeader header_;
+};
+
+}
@@ -0,0 +1,360 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : external-memory selection for K larger than RAM (POSIX)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      // source replays the whole input every time it is called
+ *      auto source = [&](auto&& emit) { for (const auto& row : table) { emit(row); } };
+ *      k::ExternalTop<Row, double>::compute(
+ *          [&](const Row& row, double score) { out.write(row); },   // called K times, best first
+ *          2000000000, source, scoringFunction);
+ *
+ *  1. a sampling pass counts the input and keeps a reservoir sample of scores
+ *  2. the K-th best score is estimated from the sample (with a safety margin) and a partition pass spills only
+ *     candidates at least as good as that cut to a temporary file (repeated with a looser cut if too few survive)
+ *  3. survivors are sorted with an external merge sort (sorted runs truncated to K, k-way merge) and emitted
+ *
+ *  All file I/O is sequential. Memory use is ExternalOptions::memoryBytes for the sort runs and merge buffers (at
+ *  least one record per merged run), plus a write buffer of memoryBytes / 16 (at most 1 MB) for each of the up to
+ *  four temporary files open at once (input spill, runs, two merge passes), plus the reservoir of sampleSize scores.
+ *  Candidate and score types must be trivially copyable (they are spilled as raw bytes).
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include <string>
+#include <random>
+#include <memory>
+#include <cmath>
+#include <cerrno>
+#include <system_error>
+#include <unistd.h>
+namespace k {
+
+struct ExternalOptions {
+    size_t memoryBytes = 256 << 20;     // memory for sort runs and merge buffers (temp file buffers take 1/16 more each)
+    size_t sampleSize = 1 << 16;        // scores kept by the sampling pass
+    double margin = 4.0;                // standard deviations added to the sampled cut
+    size_t maxFanIn = 256;              // runs merged at once, more runs are merged in several passes
+    std::string tempDirectory = "/tmp";
+};
+
+template <typename T, typename ScoreType, class CompareType>
+class ExternalSelect {
+public:
+    using Candidate = T;
+    using Score = ScoreType;
+    using ScoringFunction = std::function<Score(const Candidate&)>;
+    using Compare = CompareType;
+
+    static_assert(std::is_trivially_copyable_v<Candidate> && std::is_trivially_copyable_v<Score>,
+                  "external selection spills candidates and scores as raw bytes");
+
+    /**
+     * Calls sink(candidate, score) for the K best candidates, best first. Returns the number of candidates emitted.
+     * source(emit) must replay the same input on every call, emit(candidate) takes one candidate.
+     * Throws std::system_error on temporary file errors.
+     */
+    template <typename Sink, typename Source>
+    static size_t compute(Sink sink, size_t k, Source source, ScoringFunction scorer, const ExternalOptions& options = {}) {
+        if (k == 0) { return 0; }
+        Compare compare;
+
+        // sampling pass
+        std::vector<Score> sample;
+        sample.reserve(options.sampleSize);
+        std::mt19937_64 random(0x5e1ec7);
+        uint64_t count = 0;
+        source([&](const Candidate& candidate) {
+            Score score = scorer(candidate);
+            if (sample.size() < options.sampleSize) {
+                sample.push_back(score);
+            } else {
+                uint64_t slot = std::uniform_int_distribution<uint64_t>(0, count)(random);
+                if (slot < options.sampleSize) {
+                    sample[slot] = score;
+                }
+            }
+            ++count;
+        });
+        // best first
+        std::sort(sample.begin(), sample.end(), compare);
+
+        // partition passes : spill candidates at least as good as the cut, loosen the cut until K survive
+        const uint64_t wanted = std::min<uint64_t>(k, count);
+        TempFile spill(options);
+        double margin = options.margin;
+        for (;;) {
+            bool cutAll = true;
+            Score cut {};
+            if (wanted < count && !sample.empty()) {
+                double p = static_cast<double>(wanted) / static_cast<double>(count);
+                double s = static_cast<double>(sample.size());
+                // a negative margin can push the position below the first sample
+                double position = std::max(0.0, p * s + margin * std::sqrt(s * p * (1.0 - p)) + 1.0);
+                if (position < s) {
+                    cut = sample[static_cast<size_t>(position)];
+                    cutAll = false;
+                }
+            }
+            spill.reset();
+            uint64_t spilled = 0;
+            source([&](const Candidate& candidate) {
+                Score score = scorer(candidate);
+                if (cutAll || !compare(cut, score)) {
+                    spill.append(Record { candidate, score });
+                    ++spilled;
+                }
+            });
+            spill.flush();
+            if (spilled >= wanted || cutAll) { break; }
+            margin = margin * 2 + 4;
+        }
+        return sortSpill(sink, k, spill, options);
+    }
+
+private:
+    struct Record {
+        Candidate candidate;
+        Score score;
+    };
+
+    struct RecordCompare {
+        Compare compare;
+        bool operator()(const Record& r1, const Record& r2) const {
+            return compare(r1.score, r2.score);
+        }
+    };
+
+    // unlinked temporary file with buffered sequential appends and positional reads
+    class TempFile {
+    public:
+        // in options.tempDirectory, appends are buffered in memoryBytes / 16 (at most kMaxBufferBytes)
+        explicit TempFile(const ExternalOptions& options)
+            : bufferRecords_(std::max<size_t>(1, std::min(options.memoryBytes / 16, kMaxBufferBytes) / sizeof(Record))) {
+            std::string pattern = options.tempDirectory + "/select_k_XXXXXX";
+            fd_ = ::mkstemp(pattern.data());
+            if (fd_ < 0) {
+                throw std::system_error(errno, std::generic_category(), "mkstemp " + pattern);
+            }
+            ::unlink(pattern.c_str());
+            buffer_.reserve(bufferRecords_);
+        }
+        TempFile(const TempFile&) = delete;
+        TempFile& operator=(const TempFile&) = delete;
+        ~TempFile() {
+            ::close(fd_);
+        }
+
+        void reset() {
+            buffer_.clear();
+            bytes_ = 0;
+            if (::ftruncate(fd_, 0) != 0) {
+                throw std::system_error(errno, std::generic_category(), "ftruncate");
+            }
+        }
+
+        void append(const Record& record) {
+            buffer_.push_back(record);
+            if (buffer_.size() == bufferRecords_) { flush(); }
+        }
+
+        void append(const Record* records, size_t n) {
+            flush();
+            write(records, n);
+        }
+
+        void flush() {
+            write(buffer_.data(), buffer_.size());
+            buffer_.clear();
+        }
+
+        // records in the file (after flush())
+        uint64_t size() const { return bytes_ / sizeof(Record); }
+
+        size_t read(Record* records, uint64_t first, size_t n) const {
+            size_t bytes = n * sizeof(Record);
+            size_t done = 0;
+            char* p = reinterpret_cast<char*>(records);
+            while (done < bytes) {
+                ssize_t got = ::pread(fd_, p + done, bytes - done, static_cast<off_t>(first * sizeof(Record) + done));
+                if (got < 0 && errno == EINTR) { continue; }
+                if (got < 0) { throw std::system_error(errno, std::generic_category(), "pread"); }
+                if (got == 0) { break; }
+                done += static_cast<size_t>(got);
+            }
+            return done / sizeof(Record);
+        }
+    private:
+        static constexpr size_t kMaxBufferBytes = 1 << 20;
+
+        void write(const Record* records, size_t n) {
+            const char* p = reinterpret_cast<const char*>(records);
+            size_t bytes = n * sizeof(Record);
+            while (bytes > 0) {
+                ssize_t written = ::pwrite(fd_, p, bytes, static_cast<off_t>(bytes_));
+                if (written < 0 && errno == EINTR) { continue; }
+                if (written < 0) { throw std::system_error(errno, std::generic_category(), "pwrite"); }
+                p += written;
+                bytes -= static_cast<size_t>(written);
+                bytes_ += static_cast<uint64_t>(written);
+            }
+        }
+
+        size_t bufferRecords_;
+        int fd_ = -1;
+        uint64_t bytes_ = 0;
+        std::vector<Record> buffer_;
+    };
+
+    struct Run {
+        uint64_t first;
+        uint64_t count;
+    };
+
+    // sequential reader of one sorted run
+    class Cursor {
+    public:
+        Cursor(const TempFile& file, Run run, size_t bufferRecords)
+            : file_(file), next_(run.first), end_(run.first + run.count), buffer_(std::max<size_t>(1, bufferRecords)) {
+            fill();
+        }
+        bool done() const { return offset_ == filled_; }
+        const Record& top() const { return buffer_[offset_]; }
+        void pop() {
+            if (++offset_ == filled_) { fill(); }
+        }
+    private:
+        void fill() {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(buffer_.size(), end_ - next_));
+            filled_ = n == 0 ? 0 : file_.read(buffer_.data(), next_, n);
+            next_ += filled_;
+            offset_ = 0;
+        }
+        const TempFile& file_;
+        uint64_t next_;
+        uint64_t end_;
+        std::vector<Record> buffer_;
+        size_t offset_ = 0;
+        size_t filled_ = 0;
+    };
+
+    // merges sorted runs (best first), calling emit(record) for at most limit records
+    template <typename Emit>
+    static void mergeRuns(const TempFile& file, const std::vector<Run>& runs, uint64_t limit, size_t memoryBytes, Emit emit) {
+        size_t bufferRecords = memoryBytes / sizeof(Record) / (runs.size() + 1);
+        std::vector<Cursor> cursors;
+        cursors.reserve(runs.size());
+        for (const auto& run : runs) {
+            cursors.emplace_back(file, run, bufferRecords);
+        }
+        // heap of cursor indices with the best head record on top
+        RecordCompare recordCompare;
+        auto headCompare = [&](size_t c1, size_t c2) { return recordCompare(cursors[c2].top(), cursors[c1].top()); };
+        std::vector<size_t> heap;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            if (!cursors[i].done()) { heap.push_back(i); }
+        }
+        std::make_heap(heap.begin(), heap.end(), headCompare);
+        for (uint64_t emitted = 0; emitted < limit && !heap.empty(); ++emitted) {
+            std::pop_heap(heap.begin(), heap.end(), headCompare);
+            Cursor& cursor = cursors[heap.back()];
+            emit(cursor.top());
+            cursor.pop();
+            if (cursor.done()) {
+                heap.pop_back();
+            } else {
+                std::push_heap(heap.begin(), heap.end(), headCompare);
+            }
+        }
+    }
+
+    template <typename Sink>
+    static size_t sortSpill(Sink& sink, size_t k, const TempFile& spill, const ExternalOptions& options) {
+        const size_t memoryRecords = std::max<size_t>(1, options.memoryBytes / sizeof(Record));
+        std::vector<Record> chunk;
+        chunk.reserve(static_cast<size_t>(std::min<uint64_t>(memoryRecords, spill.size())));
+        RecordCompare recordCompare;
+
+        // survivors fit in memory : sort and emit directly
+        if (spill.size() <= memoryRecords) {
+            chunk.resize(static_cast<size_t>(spill.size()));
+            spill.read(chunk.data(), 0, chunk.size());
+            size_t emit = std::min(k, chunk.size());
+            std::partial_sort(chunk.begin(), chunk.begin() + emit, chunk.end(), recordCompare);
+            for (size_t i = 0; i < emit; ++i) {
+                sink(chunk[i].candidate, chunk[i].score);
+            }
+            return emit;
+        }
+
+        // sorted runs, each truncated to K (nothing past the K-th record of a run can make it)
+        TempFile runsFile(options);
+        std::vector<Run> runs;
+        for (uint64_t first = 0; first < spill.size(); first += memoryRecords) {
+            chunk.resize(static_cast<size_t>(std::min<uint64_t>(memoryRecords, spill.size() - first)));
+            spill.read(chunk.data(), first, chunk.size());
+            size_t keep = std::min(k, chunk.size());
+            std::partial_sort(chunk.begin(), chunk.begin() + keep, chunk.end(), recordCompare);
+            runs.push_back({ runsFile.size(), keep });
+            runsFile.append(chunk.data(), keep);
+        }
+        std::vector<Record>().swap(chunk);
+
+        // reduce the number of runs until one merge pass can take them all
+        std::unique_ptr<TempFile> current;
+        const TempFile* source = &runsFile;
+        const size_t fanIn = std::max<size_t>(2, options.maxFanIn);
+        while (runs.size() > fanIn) {
+            auto next = std::make_unique<TempFile>(options);
+            std::vector<Run> merged;
+            for (size_t group = 0; group < runs.size(); group += fanIn) {
+                std::vector<Run> inputs(runs.begin() + group, runs.begin() + std::min(runs.size(), group + fanIn));
+                Run run { next->size(), 0 };
+                mergeRuns(*source, inputs, k, options.memoryBytes / 2, [&](const Record& record) {
+                    next->append(record);
+                    ++run.count;
+                });
+                next->flush();
+                merged.push_back(run);
+            }
+            runs.swap(merged);
+            current = std::move(next);
+            source = current.get();
+        }
+
+        size_t emitted = 0;
+        mergeRuns(*source, runs, k, options.memoryBytes, [&](const Record& record) {
+            sink(record.candidate, record.score);
+            ++emitted;
+        });
+        return emitted;
+    }
+};
+
+template <typename T, typename ScoreType>
+using ExternalTop = ExternalSelect<T, ScoreType, std::greater<ScoreType>>;
+
+template <typename T, typename ScoreType>
+using ExternalBottom = ExternalSelect<T, ScoreType, std::less<ScoreType>>;
+
+}
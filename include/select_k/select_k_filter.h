@@ -0,0 +1,104 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : allow-list bitmaps for filtered k-nearest neighbour searches
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      std::vector<uint64_t> allowed(k::Filter::words(count), 0);
+ *      for (size_t row : inStockInRegion) {
+ *          k::Filter::set(allowed, row);
+ *      }
+ *      index.search(std::back_inserter(neighbors), query, 10, k::Filter(allowed));
+ *
+ *  Same layout as the validity bitmaps of select_k_columnar.h : bit (i % 64) of word (i / 64) set means row i may be
+ *  returned. Rows past the end of the bitmap are not allowed; a default constructed Filter allows every row.
+ *
+ *  Searches take the filter as their last argument and apply it before scoring : scans over rows in row order
+ *  (k::Nearest, k::Hamming, k::QuantizedNearest, k::Pq) test 64 rows per word and skip empty words outright, while
+ *  the graph / list indexes (k::Hnsw, k::Ivf) test each row they reach and keep exploring past their usual budget
+ *  for allowed rows (or scan the allowed rows exactly when there are few). The bitmap is only referenced, it must
+ *  outlive the search.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+namespace k {
+
+class Filter {
+public:
+    // allows every row
+    Filter() = default;
+    explicit Filter(std::span<const uint64_t> allowed) : allowed_(allowed), all_(false) {}
+
+    // words needed for a bitmap of rows
+    static size_t words(size_t rows) { return (rows + 63) / 64; }
+    static void set(std::vector<uint64_t>& bitmap, size_t row) {
+        if (bitmap.size() <= row / 64) { bitmap.resize(row / 64 + 1, 0); }
+        bitmap[row / 64] |= uint64_t(1) << (row % 64);
+    }
+
+    bool all() const { return all_; }
+
+    bool allows(size_t row) const {
+        return all_ || (row / 64 < allowed_.size() && ((allowed_[row / 64] >> (row % 64)) & 1) != 0);
+    }
+
+    // bits of rows [64 * index, 64 * index + 64)
+    uint64_t word(size_t index) const {
+        if (all_) { return ~uint64_t(0); }
+        return index < allowed_.size() ? allowed_[index] : 0;
+    }
+
+    // allowed rows in [0, count)
+    size_t count(size_t count) const {
+        if (all_) { return count; }
+        size_t allowed = 0;
+        for (size_t index = 0; index < words(count); ++index) {
+            allowed += static_cast<size_t>(__builtin_popcountll(word(index) & mask(index, count)));
+        }
+        return allowed;
+    }
+
+    // calls fn(row) for the allowed rows in [0, count), in order (64 rows per word test)
+    template <typename RowFunction>
+    void forEach(size_t count, RowFunction fn) const {
+        for (size_t index = 0; index < words(count); ++index) {
+            uint64_t bits = word(index) & mask(index, count);
+            while (bits != 0) {
+                fn(index * 64 + static_cast<size_t>(__builtin_ctzll(bits)));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    // the bits of word index that fall below count
+    static uint64_t mask(size_t index, size_t count) {
+        return count >= (index + 1) * 64 ? ~uint64_t(0) : (uint64_t(1) << (count - index * 64)) - 1;
+    }
+
+private:
+    std::span<const uint64_t> allowed_;
+    bool all_ = true;
+};
+
+}
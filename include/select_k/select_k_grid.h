@@ -0,0 +1,214 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : uniform grid for k-nearest neighbours over integer 2D points
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      std::vector<std::pair<int, int>> points = ...;
+ *      k::Grid grid(points.begin(), points.end());            // cell size picked for ~kPointsPerCell points a cell
+ *
+ *      std::vector<k::Grid::Neighbor> neighbors;               // (point index, squared distance), nearest first
+ *      grid.search(std::back_inserter(neighbors), {x, y}, 4);
+ *
+ *  Points are bucketed (counting sort) into square cells over their bounding box and stored cell by cell in flat
+ *  coordinate arrays, so a cell is one contiguous run. A query visits the rings of cells at Chebyshev distance
+ *  r = 0, 1, 2 ... around its own cell. Any point in ring r is at least (r - 1) * cell + 1 away along one axis, so
+ *  the walk stops as soon as ((r - 1) * cell + 1)^2 reaches the selector's current threshold (the K-th best squared
+ *  distance); within a ring, cells whose nearest edge is already too far are skipped.
+ *
+ *  Squared distances are int64_t, so coordinates must stay within +/- 2^30 of each other's range (|dx|, |dy| < 2^31).
+ *
+ *  For dense, roughly uniform data this touches a handful of cells per query with no tree descent at all; for very
+ *  clustered data prefer k::KdTree (select_k_kdtree.h).
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+namespace k {
+
+class Grid {
+public:
+    using Point = std::pair<int, int>;
+    // (point index in the input, squared distance)
+    using Neighbor = std::pair<size_t, int64_t>;
+    // selects positions in cell order
+    using Selector = Select<size_t, int64_t, std::less<int64_t>>;
+
+    // average points per cell aimed for when no cell size is given
+    static constexpr size_t kPointsPerCell = 2;
+    // bounds on the number of cells (the cell size is raised past them)
+    static constexpr size_t kMinCells = 1024;
+    static constexpr size_t kMaxCellsPerPoint = 4;
+
+    template <typename InputIterator>
+    Grid(InputIterator begin, InputIterator end, int64_t cellSize = 0) {
+        std::vector<Point> points(begin, end);
+        if (points.empty()) { return; }
+        minX_ = maxX_ = points[0].first;
+        minY_ = maxY_ = points[0].second;
+        for (const Point& p : points) {
+            minX_ = std::min<int64_t>(minX_, p.first);
+            maxX_ = std::max<int64_t>(maxX_, p.first);
+            minY_ = std::min<int64_t>(minY_, p.second);
+            maxY_ = std::max<int64_t>(maxY_, p.second);
+        }
+        if (cellSize <= 0) {
+            double area = double(maxX_ - minX_ + 1) * double(maxY_ - minY_ + 1);
+            cellSize = std::max<int64_t>(1, static_cast<int64_t>(std::ceil(std::sqrt(area * kPointsPerCell / points.size()))));
+        }
+        // a cell size too small for the bounding box is raised so the cell table stays O(points)
+        const double maxCells = double(std::max<size_t>(kMinCells, points.size() * kMaxCellsPerPoint));
+        while (double((maxX_ - minX_) / cellSize + 1) * double((maxY_ - minY_) / cellSize + 1) > maxCells) {
+            cellSize *= 2;
+        }
+        cell_ = cellSize;
+        columns_ = (maxX_ - minX_) / cell_ + 1;
+        rows_ = (maxY_ - minY_) / cell_ + 1;
+
+        // counting sort by cell : cellStart_[c] .. cellStart_[c + 1] are the positions of cell c
+        cellStart_.assign(static_cast<size_t>(columns_ * rows_) + 1, 0);
+        std::vector<size_t> cells(points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            cells[i] = cellOf(points[i].first, points[i].second);
+            ++cellStart_[cells[i] + 1];
+        }
+        for (size_t c = 1; c < cellStart_.size(); ++c) {
+            cellStart_[c] += cellStart_[c - 1];
+        }
+        xs_.resize(points.size());
+        ys_.resize(points.size());
+        ids_.resize(points.size());
+        std::vector<size_t> next(cellStart_.begin(), cellStart_.end() - 1);
+        for (size_t i = 0; i < points.size(); ++i) {
+            size_t position = next[cells[i]]++;
+            xs_[position] = points[i].first;
+            ys_[position] = points[i].second;
+            ids_[position] = i;
+        }
+    }
+
+    size_t count() const { return ids_.size(); }
+    int64_t cellSize() const { return cell_; }
+
+    // the K nearest points to query as Neighbor (index, squared distance), nearest first
+    template <typename OutputIterator>
+    size_t search(OutputIterator out, Point query, size_t k) const {
+        Selector selector = select(query, k);
+        std::vector<std::pair<size_t, int64_t>> positions;
+        positions.reserve(selector.size());
+        selector.scoredResults(std::back_inserter(positions), true);
+        for (auto [position, distance] : positions) {
+            *out++ = Neighbor(ids_[position], distance);
+        }
+        return positions.size();
+    }
+
+    // selector of positions (map with id()) holding the K nearest points to query
+    Selector select(Point query, size_t k) const {
+        Selector selector(k, [this, query](const size_t& position) { return distance(query, position); });
+        if (k == 0 || ids_.empty()) { return selector; }
+        const int64_t qx = query.first;
+        const int64_t qy = query.second;
+        // the query's cell, possibly outside the grid
+        const int64_t cx = floorDiv(qx - minX_, cell_);
+        const int64_t cy = floorDiv(qy - minY_, cell_);
+        // beyond this ring every cell lies outside the grid
+        const int64_t lastRing = std::max({cx, columns_ - 1 - cx, cy, rows_ - 1 - cy});
+        for (int64_t r = std::max<int64_t>(0, std::max({-cx, cx - (columns_ - 1), -cy, cy - (rows_ - 1)})); r <= lastRing; ++r) {
+            if (r > 0 && selector.full()) {
+                const int64_t gap = (r - 1) * cell_ + 1;
+                if (gap * gap >= selector.threshold()) { break; }
+            }
+            // top and bottom rows of the ring, then the left and right columns between them (clipped to the grid)
+            const int64_t x0 = std::max<int64_t>(cx - r, 0), x1 = std::min(cx + r, columns_ - 1);
+            const int64_t y0 = std::max<int64_t>(cy - r + 1, 0), y1 = std::min(cy + r - 1, rows_ - 1);
+            for (int64_t x = x0; x <= x1; ++x) {
+                visitCell(selector, qx, qy, x, cy - r);
+                if (r > 0) { visitCell(selector, qx, qy, x, cy + r); }
+            }
+            for (int64_t y = y0; y <= y1; ++y) {
+                visitCell(selector, qx, qy, cx - r, y);
+                visitCell(selector, qx, qy, cx + r, y);
+            }
+        }
+        return selector;
+    }
+
+    // input index of the point at a position
+    size_t id(size_t position) const { return ids_[position]; }
+    Point point(size_t position) const { return Point(xs_[position], ys_[position]); }
+
+    int64_t distance(Point query, size_t position) const {
+        int64_t dx = int64_t(query.first) - xs_[position];
+        int64_t dy = int64_t(query.second) - ys_[position];
+        return dx * dx + dy * dy;
+    }
+
+protected:
+    static int64_t floorDiv(int64_t a, int64_t b) {
+        int64_t q = a / b;
+        return (a % b != 0 && a < 0) ? q - 1 : q;
+    }
+
+    size_t cellOf(int64_t x, int64_t y) const {
+        return static_cast<size_t>(((y - minY_) / cell_) * columns_ + (x - minX_) / cell_);
+    }
+
+    // squared distance from (qx, qy) to the nearest point of the cell's square
+    int64_t cellDistance(int64_t qx, int64_t qy, int64_t x, int64_t y) const {
+        const int64_t left = minX_ + x * cell_;
+        const int64_t top = minY_ + y * cell_;
+        const int64_t dx = qx < left ? left - qx : (qx > left + cell_ - 1 ? qx - (left + cell_ - 1) : 0);
+        const int64_t dy = qy < top ? top - qy : (qy > top + cell_ - 1 ? qy - (top + cell_ - 1) : 0);
+        return dx * dx + dy * dy;
+    }
+
+    void visitCell(Selector& selector, int64_t qx, int64_t qy, int64_t x, int64_t y) const {
+        if (x < 0 || x >= columns_ || y < 0 || y >= rows_) { return; }
+        const size_t c = static_cast<size_t>(y * columns_ + x);
+        const size_t begin = cellStart_[c];
+        const size_t end = cellStart_[c + 1];
+        if (begin == end) { return; }
+        if (selector.full() && cellDistance(qx, qy, x, y) >= selector.threshold()) { return; }
+        for (size_t position = begin; position < end; ++position) {
+            const int64_t dx = qx - xs_[position];
+            const int64_t dy = qy - ys_[position];
+            const int64_t d = dx * dx + dy * dy;
+            if (!selector.full() || d < selector.threshold()) {
+                selector.offerScored(position, d);
+            }
+        }
+    }
+
+    int64_t minX_ = 0, maxX_ = 0, minY_ = 0, maxY_ = 0;
+    int64_t cell_ = 1;
+    int64_t columns_ = 0, rows_ = 0;
+    std::vector<size_t> cellStart_;
+    std::vector<int> xs_;
+    std::vector<int> ys_;
+    std::vector<size_t> ids_;
+};
+
+}
@@ -0,0 +1,205 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : hamming distance k-nearest neighbours over packed binary codes (SimHash, binary embeddings)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      // count codes of 256 bits, 4 uint64_t words each, back to back
+ *      k::Hamming index(codes.data(), count, 4);
+ *
+ *      std::vector<k::Hamming::Neighbor> neighbors;    // (row, hamming distance), nearest first
+ *      index.search(std::back_inserter(neighbors), query, 10);
+ *
+ *      auto results = index.searchBatch(queries.data(), queryCount, 10);
+ *      index.search(std::back_inserter(neighbors), query, 10, k::Filter(allowed));  // allow-list (select_k_filter.h)
+ *
+ *  Distances come from simd::hammingBlock : popcount(query ^ code) with AVX-512 VPOPCNTDQ where available,
+ *  AVX2 nibble lookups (pshufb + psadbw) otherwise, and popcnt for the words left over.
+ *
+ *  A distance is an integer in 0 .. bits, so selection does not need a comparison heap : k::BucketSelect keeps
+ *  one bucket per distance and a cutoff that drops to the smallest distance still holding the K best, so an offer
+ *  is one compare and a push, and results come out already sorted. Ties keep the earlier row.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k_filter.h"
+#include "select_k/select_k_kmeans.h"
+#include "select_k/select_k_simd.h"
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+namespace k {
+
+/**
+ * bounded selector of the K smallest of small integer scores (0 .. maxScore), ties by arrival
+ * (the counterpart of k::Bottom when scores are bucketable)
+ */
+template <typename T>
+class BucketSelect {
+public:
+    BucketSelect(size_t k, uint32_t maxScore) : k_(k), limit_(maxScore), buckets_(size_t(maxScore) + 1) {}
+
+    size_t k() const { return k_; }
+    size_t size() const { return std::min(kept_, k_); }
+    bool full() const { return kept_ >= k_; }
+    // the largest score that may still be admitted
+    uint32_t threshold() const { return limit_; }
+
+    bool admits(uint32_t score) const { return k_ != 0 && (full() ? score < limit_ : score <= limit_); }
+
+    bool offerScored(const T& item, uint32_t score) {
+        if (!admits(score)) { return false; }
+        buckets_[score].push_back(item);
+        ++kept_;
+        // drop the cutoff bucket while the buckets below it already hold K
+        while (kept_ - buckets_[limit_].size() >= k_) {
+            kept_ -= buckets_[limit_].size();
+            buckets_[limit_].clear();
+            --limit_;
+        }
+        return true;
+    }
+
+    // (item, score) pairs, best first
+    template <typename OutputIterator>
+    size_t scoredResults(OutputIterator out) const {
+        size_t emitted = 0;
+        for (uint32_t score = 0; score <= limit_ && emitted < k_; ++score) {
+            for (const T& item : buckets_[score]) {
+                if (emitted == k_) { break; }
+                *out++ = std::make_pair(item, score);
+                ++emitted;
+            }
+        }
+        return emitted;
+    }
+
+    void clear(uint32_t maxScore) {
+        for (uint32_t score = 0; score <= limit_; ++score) {
+            buckets_[score].clear();
+        }
+        buckets_.resize(size_t(maxScore) + 1);
+        limit_ = maxScore;
+        kept_ = 0;
+    }
+
+private:
+    size_t k_;
+    uint32_t limit_;
+    size_t kept_ = 0;
+    std::vector<std::vector<T>> buckets_;
+};
+
+class Hamming {
+public:
+    // (row index, hamming distance)
+    using Neighbor = std::pair<size_t, uint32_t>;
+
+    // codes scored in one kernel call
+    static constexpr size_t kBlock = 256;
+
+    // count codes of words uint64_t each (kept by reference, must outlive the index)
+    Hamming(const uint64_t* codes, size_t count, size_t words) : codes_(codes), count_(count), words_(words) {}
+
+    size_t count() const { return count_; }
+    size_t words() const { return words_; }
+    uint32_t bits() const { return static_cast<uint32_t>(words_ * 64); }
+
+    uint32_t distance(const uint64_t* query, size_t row) const {
+        uint32_t d = 0;
+        simd::hammingBlock(query, codes_ + row * words_, 1, words_, &d);
+        return d;
+    }
+
+    // the K nearest codes to query (words uint64_t) among the rows filter allows, nearest first, ties by row
+    template <typename OutputIterator>
+    size_t search(OutputIterator out, const uint64_t* query, size_t k, const Filter& filter = {}) const {
+        BucketSelect<size_t> selector(k, bits());
+        scan(query, selector, filter);
+        return selector.scoredResults(out);
+    }
+
+    // the K nearest codes to each of queryCount queries (back to back), query chunks split over threads (0 = one per core)
+    std::vector<std::vector<Neighbor>> searchBatch(const uint64_t* queries, size_t queryCount, size_t k,
+                                                   size_t threads = 0, const Filter& filter = {}) const {
+        std::vector<std::vector<Neighbor>> neighbors(queryCount);
+        if (threads == 0) {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        KMeans::forEachChunk(queryCount, std::min(threads, queryCount), [&](size_t, size_t begin, size_t end) {
+            BucketSelect<size_t> selector(k, bits());
+            for (size_t q = begin; q < end; ++q) {
+                selector.clear(bits());
+                scan(queries + q * words_, selector, filter);
+                selector.scoredResults(std::back_inserter(neighbors[q]));
+            }
+        });
+        return neighbors;
+    }
+
+protected:
+    void scan(const uint64_t* query, BucketSelect<size_t>& selector, const Filter& filter) const {
+        if (selector.k() == 0) { return; }
+        uint32_t distances[kBlock];
+        if (filter.all()) {
+            for (size_t first = 0; first < count_; first += kBlock) {
+                const size_t rows = std::min(kBlock, count_ - first);
+                simd::hammingBlock(query, codes_ + first * words_, rows, words_, distances);
+                offer(selector, first, distances, rows);
+            }
+            return;
+        }
+        // 64 rows per filter word : empty words are skipped, full ones scored as a block
+        for (size_t index = 0; index < Filter::words(count_); ++index) {
+            const uint64_t mask = Filter::mask(index, count_);
+            uint64_t bits = filter.word(index) & mask;
+            const size_t first = index * 64;
+            if (bits == mask) {
+                const size_t rows = std::min<size_t>(64, count_ - first);
+                simd::hammingBlock(query, codes_ + first * words_, rows, words_, distances);
+                offer(selector, first, distances, rows);
+                continue;
+            }
+            for (; bits != 0; bits &= bits - 1) {
+                const size_t row = first + static_cast<size_t>(__builtin_ctzll(bits));
+                const uint32_t d = distance(query, row);
+                if (selector.admits(d)) {
+                    selector.offerScored(row, d);
+                }
+            }
+        }
+    }
+
+    static void offer(BucketSelect<size_t>& selector, size_t first, const uint32_t* distances, size_t rows) {
+        for (size_t i = 0; i < rows; ++i) {
+            if (selector.admits(distances[i])) {
+                selector.offerScored(first + i, distances[i]);
+            }
+        }
+    }
+
+    const uint64_t* codes_;
+    size_t count_;
+    size_t words_;
+};
+
+}
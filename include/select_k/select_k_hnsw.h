@@ -0,0 +1,596 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : HNSW (hierarchical navigable small world) approximate nearest neighbours
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      // base : count x dim floats, row major (not copied - must outlive the index)
+ *      k::HnswOptions options;                 // M, efConstruction, efSearch, threads
+ *      k::Hnsw index(base.data(), count, dim, k::Metric::L2, options);
+ *      index.build();                          // parallel insertion of every row
+ *      index.save("base.hnsw");                // the graph only - the vectors stay wherever base lives
+ *
+ *      std::vector<k::Nearest::Neighbor> neighbors;   // (row, squared distance or similarity), nearest first
+ *      index.search(std::back_inserter(neighbors), query, 10);
+ *      index.search(std::back_inserter(neighbors), query, 10, 0, k::Filter(allowed));   // allow-list (select_k_filter.h)
+ *
+ *      k::Hnsw loaded(base.data(), count, dim, k::Metric::L2);
+ *      loaded.load("base.hnsw");               // false if the file holds an index of other rows / metric
+ *
+ *  Every layer search keeps its beam (the ef nearest nodes found so far) in a bounded k::Select : a candidate is
+ *  only expanded while it is nearer than the beam's threshold, exactly the bounded selection the rest of the
+ *  library does. Links are stored in flat arrays : layer 0 gets 2 * M + 1 uint32 slots per node (count, ids),
+ *  upper layers M + 1 slots per layer for the few nodes that reach them. Node levels are drawn up front so the
+ *  arrays are allocated once, then rows are inserted by all threads with a striped lock guarding each link list.
+ *
+ *  A filtered search still walks through disallowed nodes (they keep the graph connected) but only allowed nodes
+ *  enter the beam, so it explores until it holds ef allowed nodes. When the filter allows no more rows than such a
+ *  walk would score (ef * M), those rows are scanned exactly instead.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include "select_k/select_k_filter.h"
+#include "select_k/select_k_codec.h"
+#include "select_k/select_k_vector.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+namespace k {
+
+struct HnswOptions {
+    size_t M = 16;                  // links per node on the upper layers (2 * M on layer 0)
+    size_t efConstruction = 200;    // beam width while inserting (raised to M if smaller)
+    size_t efSearch = 64;           // default beam width of search() (raised to K if smaller)
+    size_t threads = 0;             // insertion threads, 0 = one per core
+    uint64_t seed = 100;            // level assignment
+};
+
+class Hnsw {
+public:
+    // (row index, score) - squared distance for Metric::L2, similarity otherwise (as k::Nearest)
+    using Neighbor = std::pair<size_t, float>;
+    // the ef nearest nodes found so far by a layer search, by distance (similarities are negated)
+    using Beam = Select<uint32_t, float, std::less<float>>;
+
+    // serialized graph header : magic "HNSW", format version
+    static constexpr uint32_t kSerialMagic = 0x57534e48;
+    static constexpr uint32_t kSerialVersion = 1;
+    static constexpr size_t kLockStripes = 4096;
+    // bounds on a node's level and on M (a loaded graph past them is rejected)
+    static constexpr size_t kMaxLevel = 30;
+    static constexpr size_t kMaxM = 4096;
+    // link slots read (and allocated) at a time by deserialize()
+    static constexpr size_t kReadChunk = 1 << 16;
+
+    /**
+     * an empty index over the count rows of data (nothing is linked until build() or load())
+     */
+    Hnsw(const float* data, size_t count, size_t dim, Metric metric = Metric::L2, HnswOptions options = {})
+        : data_(data), count_(count), dim_(dim), metric_(metric), options_(options),
+          maxM_(std::max<size_t>(2, options.M)), maxM0_(2 * maxM_), locks_(kLockStripes) {
+        // an insert keeps up to M of the beam as neighbors, an empty beam has no threshold and no nearest node
+        options_.efConstruction = std::max(options_.efConstruction, maxM_);
+        if (metric_ == Metric::Cosine) {
+            inverseNorms_.resize(count_);
+            for (size_t i = 0; i < count_; ++i) {
+                float norm = std::sqrt(simd::dot(row(i), row(i), dim_));
+                inverseNorms_[i] = norm > 0 ? 1.0f / norm : 0.0f;
+            }
+        }
+    }
+
+    Hnsw(const Hnsw&) = delete;
+    Hnsw& operator=(const Hnsw&) = delete;
+
+    size_t count() const { return count_; }
+    size_t dim() const { return dim_; }
+    Metric metric() const { return metric_; }
+    const HnswOptions& options() const { return options_; }
+    const float* row(size_t index) const { return data_ + index * dim_; }
+
+    // links every row into the graph, rows are inserted in parallel (options.threads)
+    void build() {
+        std::mt19937_64 random(options_.seed);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        const double levelScale = 1.0 / std::log(double(maxM_));
+        std::vector<uint8_t> levels(count_);
+        for (size_t i = 0; i < count_; ++i) {
+            double level = -std::log(std::max(uniform(random), 1e-12)) * levelScale;
+            levels[i] = static_cast<uint8_t>(std::min(level, double(kMaxLevel)));
+        }
+        allocate(std::move(levels));
+        if (count_ == 0) { return; }
+
+        entry_ = 0;
+        maxLevel_ = levels_[0];
+        std::atomic<size_t> next(1);
+        auto insertRows = [this, &next]() {
+            std::unique_ptr<Visited> visited = acquireVisited();
+            std::vector<float> prepared;
+            for (size_t i = next++; i < count_; i = next++) {
+                insert(static_cast<uint32_t>(i), prepare(row(i), prepared), *visited);
+            }
+            releaseVisited(std::move(visited));
+        };
+        size_t threads = options_.threads;
+        if (threads == 0) {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        threads = std::min(threads, count_);
+        if (threads <= 1) {
+            insertRows();
+        } else {
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (size_t worker = 0; worker < threads; ++worker) {
+                workers.emplace_back(insertRows);
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+    }
+
+    /**
+     * the (approximate) K nearest rows to query among the rows filter allows, nearest first
+     * ef is the beam width on layer 0 (0 = options.efSearch), larger is slower and more accurate
+     */
+    template <typename OutputIterator>
+    size_t search(OutputIterator out, const float* query, size_t k, size_t ef = 0, const Filter& filter = {}) const {
+        if (k == 0 || levels_.empty()) { return 0; }
+        std::vector<float> prepared;
+        query = prepare(query, prepared);
+        ef = std::max({ef == 0 ? options_.efSearch : ef, k});
+        Beam beam = !filter.all() && filter.count(count_) <= ef * options_.M ? scanAllowed(query, k, filter)
+                                                                           : searchGraph(query, ef, filter);
+        std::vector<std::pair<uint32_t, float>> found;
+        beam.scoredResults(std::back_inserter(found), true);
+        const size_t n = std::min(k, found.size());
+        for (size_t i = 0; i < n; ++i) {
+            *out++ = Neighbor(found[i].first, metric_ == Metric::L2 ? found[i].second : -found[i].second);
+        }
+        return n;
+    }
+
+    /**
+     * Writes the graph (not the vectors) : header, count, dim, metric, M, ef settings, entry point, node levels,
+     * then the layer 0 and upper layer link arrays with one bulk write each.
+     */
+    template <typename Codec>
+    void serialize(Codec& codec) const {
+        uint32_t header[4] = { kSerialMagic, kSerialVersion, static_cast<uint32_t>(metric_), levels_.empty() ? 0u : 1u };
+        uint64_t sizes[5] = { count_, dim_, maxM_, options_.efConstruction, options_.efSearch };
+        uint32_t entry[2] = { entry_, maxLevel_ };
+        codec.write(header, sizeof(header));
+        codec.write(sizes, sizeof(sizes));
+        codec.write(entry, sizeof(entry));
+        if (levels_.empty()) { return; }
+        codec.write(levels_.data(), levels_.size());
+        codec.write(links0_.data(), links0_.size() * sizeof(uint32_t));
+        codec.write(upperLinks_.data(), upperLinks_.size() * sizeof(uint32_t));
+    }
+
+    /**
+     * Restores a graph written by serialize() for the same rows (count, dim) and metric.
+     * Returns false (leaving the index untouched) on a truncated stream, a mismatched header, M or a node level out
+     * of bounds, or a link list that is longer than its level allows or links a node that does not exist at that
+     * level. Everything is decoded and checked before the index is replaced. A stored efConstruction below M is
+     * raised to M, as in the constructor.
+     */
+    template <typename Codec>
+    bool deserialize(Codec& codec) {
+        uint32_t header[4];
+        uint64_t sizes[5];
+        uint32_t entry[2];
+        if (!codec.read(header, sizeof(header)) || !codec.read(sizes, sizeof(sizes)) || !codec.read(entry, sizeof(entry))) {
+            return false;
+        }
+        if (header[0] != kSerialMagic || header[1] != kSerialVersion || header[2] != static_cast<uint32_t>(metric_) ||
+            sizes[0] != count_ || sizes[1] != dim_ || sizes[2] < 2 || sizes[2] > kMaxM) {
+            return false;
+        }
+        const size_t maxM = static_cast<size_t>(sizes[2]);
+        std::vector<uint8_t> levels;
+        std::vector<uint32_t> links0;
+        std::vector<size_t> upperOffsets;
+        std::vector<uint32_t> upperLinks;
+        if (header[3] != 0) {
+            levels.resize(count_);
+            if (!codec.read(levels.data(), levels.size())) { return false; }
+            for (uint8_t level : levels) {
+                if (level > kMaxLevel) { return false; }
+            }
+            if (entry[0] >= count_ || entry[1] != levels[entry[0]]) { return false; }
+            const size_t upper = upperLayout(levels, maxM, upperOffsets);
+            if (!readLinks(codec, links0, count_ * (2 * maxM + 1)) || !readLinks(codec, upperLinks, upper) ||
+                !validLinks(levels, links0, upperOffsets, upperLinks, maxM)) {
+                return false;
+            }
+        }
+        maxM_ = maxM;
+        maxM0_ = 2 * maxM;
+        options_.M = maxM;
+        options_.efConstruction = static_cast<size_t>(std::max<uint64_t>(sizes[3], maxM));
+        options_.efSearch = static_cast<size_t>(sizes[4]);
+        levels_ = std::move(levels);
+        links0_ = std::move(links0);
+        upperOffsets_ = std::move(upperOffsets);
+        upperLinks_ = std::move(upperLinks);
+        entry_ = levels_.empty() ? 0 : entry[0];
+        maxLevel_ = levels_.empty() ? 0 : entry[1];
+        return true;
+    }
+
+    // serialize() into a file, throws std::system_error on I/O errors
+    void save(const std::string& path) const {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        try {
+            FdCodec codec(fd);
+            serialize(codec);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        if (::close(fd) != 0) {
+            throw std::system_error(errno, std::generic_category(), "close " + path);
+        }
+    }
+
+    // deserialize() from a file, throws std::system_error if it cannot be opened
+    bool load(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        FdCodec codec(fd);
+        bool ok = deserialize(codec);
+        ::close(fd);
+        return ok;
+    }
+
+protected:
+    // per search visited marks : node i was reached in the current search if tags[i] == epoch
+    struct Visited {
+        std::vector<uint32_t> tags;
+        uint32_t epoch = 0;
+
+        void next() {
+            if (++epoch == 0) {
+                std::fill(tags.begin(), tags.end(), 0);
+                epoch = 1;
+            }
+        }
+    };
+
+    // visited marks are pooled so a search does not allocate (and clear) one tag per row
+    std::unique_ptr<Visited> acquireVisited() const {
+        {
+            std::lock_guard<std::mutex> guard(visitedMutex_);
+            if (!visitedPool_.empty()) {
+                std::unique_ptr<Visited> visited = std::move(visitedPool_.back());
+                visitedPool_.pop_back();
+                return visited;
+            }
+        }
+        auto visited = std::make_unique<Visited>();
+        visited->tags.assign(count_, 0);
+        return visited;
+    }
+
+    void releaseVisited(std::unique_ptr<Visited> visited) const {
+        std::lock_guard<std::mutex> guard(visitedMutex_);
+        visitedPool_.push_back(std::move(visited));
+    }
+
+    // sizes the link arrays for the given node levels (all lists empty)
+    void allocate(std::vector<uint8_t> levels) {
+        levels_ = std::move(levels);
+        links0_.assign(count_ * (maxM0_ + 1), 0);
+        upperLinks_.assign(upperLayout(levels_, maxM_, upperOffsets_), 0);
+    }
+
+    // offsets[i] = start of node i's upper layer lists (M + 1 slots per level above 0), returns the total slots
+    static size_t upperLayout(const std::vector<uint8_t>& levels, size_t maxM, std::vector<size_t>& offsets) {
+        offsets.resize(levels.size());
+        size_t upper = 0;
+        for (size_t i = 0; i < levels.size(); ++i) {
+            offsets[i] = upper;
+            upper += levels[i] * (maxM + 1);
+        }
+        return upper;
+    }
+
+    // link list of node at level : list[0] is the number of links, list[1 ..] the linked nodes
+    uint32_t* links(uint32_t node, size_t level) {
+        return level == 0 ? links0_.data() + node * (maxM0_ + 1) : upperLinks_.data() + upperOffsets_[node] + (level - 1) * (maxM_ + 1);
+    }
+    const uint32_t* links(uint32_t node, size_t level) const {
+        return level == 0 ? links0_.data() + node * (maxM0_ + 1) : upperLinks_.data() + upperOffsets_[node] + (level - 1) * (maxM_ + 1);
+    }
+
+    // reads slots uint32s kReadChunk at a time, so a corrupt size ends in a short read rather than one huge allocation
+    template <typename Codec>
+    static bool readLinks(Codec& codec, std::vector<uint32_t>& out, size_t slots) {
+        out.clear();
+        for (size_t done = 0; done < slots;) {
+            const size_t chunk = std::min(slots - done, kReadChunk);
+            out.resize(done + chunk);
+            if (!codec.read(out.data() + done, chunk * sizeof(uint32_t))) { return false; }
+            done += chunk;
+        }
+        return true;
+    }
+
+    // whether every loaded link list fits its slots and links only nodes that exist at that level
+    static bool validLinks(const std::vector<uint8_t>& levels, const std::vector<uint32_t>& links0,
+                           const std::vector<size_t>& upperOffsets, const std::vector<uint32_t>& upperLinks, size_t maxM) {
+        const size_t count = levels.size();
+        for (size_t node = 0; node < count; ++node) {
+            for (size_t level = 0; level <= levels[node]; ++level) {
+                const uint32_t* list = level == 0 ? links0.data() + node * (2 * maxM + 1)
+                                                  : upperLinks.data() + upperOffsets[node] + (level - 1) * (maxM + 1);
+                if (list[0] > (level == 0 ? 2 * maxM : maxM)) { return false; }
+                for (uint32_t i = 1; i <= list[0]; ++i) {
+                    if (list[i] >= count || levels[list[i]] < level) { return false; }
+                }
+            }
+        }
+        return true;
+    }
+
+    std::mutex& lockOf(uint32_t node) const { return locks_[node % kLockStripes]; }
+
+    // copy of a link list (under the node's lock while the graph is being built)
+    void readLinks(uint32_t node, size_t level, bool locked, std::vector<uint32_t>& out) const {
+        const uint32_t* list = links(node, level);
+        if (locked) {
+            std::lock_guard<std::mutex> guard(lockOf(node));
+            out.assign(list + 1, list + 1 + list[0]);
+        } else {
+            out.assign(list + 1, list + 1 + list[0]);
+        }
+    }
+
+    // the query as compared against rows (a unit length copy in prepared for Metric::Cosine)
+    const float* prepare(const float* query, std::vector<float>& prepared) const {
+        if (metric_ != Metric::Cosine) { return query; }
+        prepared.assign(query, query + dim_);
+        simd::normalize(prepared.data(), 1, dim_);
+        return prepared.data();
+    }
+
+    // distance (smaller is nearer) from a prepared query to a row
+    float distance(const float* query, uint32_t node) const {
+        switch (metric_) {
+        case Metric::L2:
+            return simd::squaredL2(query, row(node), dim_);
+        case Metric::InnerProduct:
+            return -simd::dot(query, row(node), dim_);
+        case Metric::Cosine:
+            return -simd::dot(query, row(node), dim_) * inverseNorms_[node];
+        }
+        return 0;
+    }
+
+    float distance(uint32_t a, uint32_t b) const {
+        float d = distance(row(a), b);
+        return metric_ == Metric::Cosine ? d * inverseNorms_[a] : d;
+    }
+
+    // greedy walk from node on each layer from top down to (but excluding) bottom, returns the nearest node found
+    uint32_t descend(const float* query, uint32_t node, size_t top, size_t bottom, bool locked) const {
+        float nearest = distance(query, node);
+        std::vector<uint32_t> neighbors;
+        for (size_t level = top; level > bottom; --level) {
+            bool moved = true;
+            while (moved) {
+                moved = false;
+                readLinks(node, level, locked, neighbors);
+                for (uint32_t neighbor : neighbors) {
+                    float d = distance(query, neighbor);
+                    if (d < nearest) {
+                        nearest = d;
+                        node = neighbor;
+                        moved = true;
+                    }
+                }
+            }
+        }
+        return node;
+    }
+
+    Beam searchGraph(const float* query, size_t ef, const Filter& filter) const {
+        std::unique_ptr<Visited> visited = acquireVisited();
+        uint32_t nearest = descend(query, entry_, maxLevel_, 0, false);
+        Beam beam = searchLayer(query, nearest, ef, 0, *visited, false, filter);
+        releaseVisited(std::move(visited));
+        return beam;
+    }
+
+    // exact scan of the rows filter allows (for filters too selective for the graph walk)
+    Beam scanAllowed(const float* query, size_t k, const Filter& filter) const {
+        Beam beam(k, [this, query](const uint32_t& node) { return distance(query, node); });
+        filter.forEach(count_, [&](size_t row) {
+            const float d = distance(query, static_cast<uint32_t>(row));
+            if (!beam.full() || d < beam.threshold()) {
+                beam.offerScored(static_cast<uint32_t>(row), d);
+            }
+        });
+        return beam;
+    }
+
+    // beam search of one layer from entry : the ef nearest (allowed) nodes reached
+    Beam searchLayer(const float* query, uint32_t entry, size_t ef, size_t level, Visited& visited, bool locked,
+                     const Filter& filter = {}) const {
+        visited.next();
+        const uint32_t epoch = visited.epoch;
+        std::vector<uint32_t>& tags = visited.tags;
+        Beam beam(ef, [this, query](const uint32_t& node) { return distance(query, node); });
+        // nodes still to expand, nearest on top
+        using Candidate = std::pair<float, uint32_t>;
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+        const float d = distance(query, entry);
+        tags[entry] = epoch;
+        if (filter.allows(entry)) {
+            beam.offerScored(entry, d);
+        }
+        candidates.push({d, entry});
+        std::vector<uint32_t> neighbors;
+        while (!candidates.empty()) {
+            auto [nearest, node] = candidates.top();
+            if (beam.full() && nearest > beam.threshold()) { break; }
+            candidates.pop();
+            readLinks(node, level, locked, neighbors);
+            for (uint32_t neighbor : neighbors) {
+                if (tags[neighbor] == epoch) { continue; }
+                tags[neighbor] = epoch;
+                float dn = distance(query, neighbor);
+                if (!beam.full() || dn < beam.threshold()) {
+                    // disallowed nodes are only walked through
+                    if (filter.allows(neighbor)) {
+                        beam.offerScored(neighbor, dn);
+                    }
+                    candidates.push({dn, neighbor});
+                }
+            }
+        }
+        return beam;
+    }
+
+    /**
+     * HNSW neighbour heuristic : walks candidates nearest first and keeps one only if it is nearer to the base
+     * node than to every neighbour already kept, so links spread out in different directions.
+     */
+    void selectNeighbors(std::vector<std::pair<uint32_t, float>>& candidates, size_t m) const {
+        if (candidates.size() <= m) { return; }
+        std::vector<std::pair<uint32_t, float>> kept;
+        kept.reserve(m);
+        for (const auto& candidate : candidates) {
+            if (kept.size() == m) { break; }
+            bool diverse = true;
+            for (const auto& other : kept) {
+                if (distance(candidate.first, other.first) < candidate.second) {
+                    diverse = false;
+                    break;
+                }
+            }
+            if (diverse) { kept.push_back(candidate); }
+        }
+        candidates.swap(kept);
+    }
+
+    // adds node to the link list of target at level, pruning the list with the heuristic once it is full
+    void connect(uint32_t target, uint32_t node, size_t level) {
+        const size_t m = level == 0 ? maxM0_ : maxM_;
+        std::lock_guard<std::mutex> guard(lockOf(target));
+        uint32_t* list = links(target, level);
+        for (uint32_t i = 1; i <= list[0]; ++i) {
+            if (list[i] == node) { return; }
+        }
+        if (list[0] < m) {
+            list[++list[0]] = node;
+            return;
+        }
+        std::vector<std::pair<uint32_t, float>> candidates;
+        candidates.reserve(m + 1);
+        for (uint32_t i = 1; i <= list[0]; ++i) {
+            candidates.push_back({list[i], distance(target, list[i])});
+        }
+        candidates.push_back({node, distance(target, node)});
+        std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+        selectNeighbors(candidates, m);
+        list[0] = static_cast<uint32_t>(candidates.size());
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            list[i + 1] = candidates[i].first;
+        }
+    }
+
+    void insert(uint32_t node, const float* query, Visited& visited) {
+        const size_t level = levels_[node];
+        // a node that raises the top level holds the entry lock for its whole insertion
+        std::unique_lock<std::mutex> entryLock(entryMutex_);
+        uint32_t entry = entry_;
+        const size_t top = maxLevel_;
+        if (level <= top) {
+            entryLock.unlock();
+        }
+        uint32_t nearest = descend(query, entry, top, level, true);
+        for (size_t l = std::min(level, top) + 1; l-- > 0;) {
+            Beam beam = searchLayer(query, nearest, options_.efConstruction, l, visited, true);
+            std::vector<std::pair<uint32_t, float>> candidates;
+            candidates.reserve(beam.size());
+            beam.scoredResults(std::back_inserter(candidates), true);
+            nearest = candidates.front().first;
+            selectNeighbors(candidates, maxM_);
+            {
+                std::lock_guard<std::mutex> guard(lockOf(node));
+                uint32_t* list = links(node, l);
+                list[0] = static_cast<uint32_t>(candidates.size());
+                for (size_t i = 0; i < candidates.size(); ++i) {
+                    list[i + 1] = candidates[i].first;
+                }
+            }
+            for (const auto& candidate : candidates) {
+                connect(candidate.first, node, l);
+            }
+        }
+        if (level > top) {
+            entry_ = node;
+            maxLevel_ = static_cast<uint32_t>(level);
+        }
+    }
+
+    const float* data_;
+    size_t count_;
+    size_t dim_;
+    Metric metric_;
+    HnswOptions options_;
+    size_t maxM_;
+    size_t maxM0_;
+    std::vector<float> inverseNorms_;
+
+    std::vector<uint8_t> levels_;
+    std::vector<uint32_t> links0_;
+    std::vector<size_t> upperOffsets_;
+    std::vector<uint32_t> upperLinks_;
+    uint32_t entry_ = 0;
+    uint32_t maxLevel_ = 0;
+
+    std::mutex entryMutex_;
+    mutable std::vector<std::mutex> locks_;
+    mutable std::mutex visitedMutex_;
+    mutable std::vector<std::unique_ptr<Visited>> visitedPool_;
+};
+
+}
@@ -0,0 +1,376 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : read-ahead block reader for files (io_uring with pread fallback, Linux / POSIX)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      k::io::FileReader reader("huge.csv");
+ *      reader.forEachBlock([&](const char* data, size_t size) {
+ *          // score the block while the next ones are being read
+ *      });
+ *
+ *  With io_uring a queue of aligned (O_DIRECT when the file system allows it) reads is kept in flight so
+ *  the disk works ahead of the consumer. Blocks are always delivered in file order. Where io_uring is not
+ *  compiled in, not permitted at runtime, or its first read fails with EINVAL / EOPNOTSUPP (an older kernel
+ *  without IORING_OP_READ) the reader falls back to plain pread(). A pipe, FIFO or other input that is not a
+ *  regular file has no size to read ahead to : it is read sequentially with read() until EOF.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <cerrno>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define SELECT_K_HAS_IO_URING 1
+#endif
+namespace k {
+namespace io {
+
+enum class Backend {
+    Auto,   // io_uring if available, else pread
+    Uring,
+    Pread,
+};
+
+class FileReader {
+public:
+    static constexpr size_t kAlignment = 4096;
+
+    // blockSize is rounded up to a multiple of kAlignment, throws std::system_error if the file cannot be opened
+    explicit FileReader(const std::string& path, size_t blockSize = 1 << 20, unsigned queueDepth = 8, Backend backend = Backend::Auto)
+        : path_(path),
+          blockSize_(std::max(kAlignment, (blockSize + kAlignment - 1) / kAlignment * kAlignment)),
+          queueDepth_(std::max(1u, queueDepth)) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        struct stat st;
+        if (::fstat(fd_, &st) != 0) {
+            int error = errno;
+            ::close(fd_);
+            throw std::system_error(error, std::generic_category(), "fstat " + path);
+        }
+        regular_ = S_ISREG(st.st_mode);
+        size_ = regular_ ? static_cast<uint64_t>(st.st_size) : 0;
+#ifdef SELECT_K_HAS_IO_URING
+        if (backend != Backend::Pread && regular_) {
+            uring_ = Ring::create(queueDepth_);
+        }
+#endif
+        (void)backend;
+    }
+
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    ~FileReader() {
+        if (fd_ >= 0) { ::close(fd_); }
+    }
+
+    // 0 for an input that is not a regular file (its size is only known at EOF)
+    uint64_t size() const { return size_; }
+    bool usingUring() const {
+#ifdef SELECT_K_HAS_IO_URING
+        return uring_ != nullptr;
+#else
+        return false;
+#endif
+    }
+
+    // calls fn(const char* data, size_t size) for every block of the file in file order
+    template <typename BlockFunction>
+    void forEachBlock(BlockFunction&& fn) {
+        if (!regular_) {
+            readSequential(fn);
+            return;
+        }
+#ifdef SELECT_K_HAS_IO_URING
+        if (uring_ != nullptr) {
+            readUring(fn);
+            return;
+        }
+#endif
+        readPread(fn);
+    }
+
+private:
+    struct AlignedFree {
+        void operator()(char* p) const { std::free(p); }
+    };
+    using Buffer = std::unique_ptr<char, AlignedFree>;
+
+    Buffer allocate() const {
+        char* p = static_cast<char*>(std::aligned_alloc(kAlignment, blockSize_));
+        if (p == nullptr) {
+            throw std::system_error(ENOMEM, std::generic_category(), "aligned_alloc");
+        }
+        return Buffer(p);
+    }
+
+    // reads [offset, offset + size) completely with pread() on fd, returns bytes read (short only at end of file)
+    size_t readFully(int fd, char* data, uint64_t offset, size_t size) const {
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = ::pread(fd, data + done, size - done, static_cast<off_t>(offset + done));
+            if (n < 0) {
+                if (errno == EINTR) { continue; }
+                throw std::system_error(errno, std::generic_category(), "pread " + path_);
+            }
+            if (n == 0) { break; }
+            done += static_cast<size_t>(n);
+        }
+        return done;
+    }
+
+    template <typename BlockFunction>
+    void readPread(BlockFunction& fn) {
+        Buffer buffer = allocate();
+        for (uint64_t offset = 0; offset < size_; offset += blockSize_) {
+            size_t n = readFully(fd_, buffer.get(), offset, static_cast<size_t>(std::min<uint64_t>(blockSize_, size_ - offset)));
+            if (n == 0) { break; }
+            fn(static_cast<const char*>(buffer.get()), n);
+        }
+    }
+
+    // no offsets and no read-ahead : read() until EOF
+    template <typename BlockFunction>
+    void readSequential(BlockFunction& fn) {
+        Buffer buffer = allocate();
+        for (;;) {
+            ssize_t n = ::read(fd_, buffer.get(), blockSize_);
+            if (n < 0) {
+                if (errno == EINTR) { continue; }
+                throw std::system_error(errno, std::generic_category(), "read " + path_);
+            }
+            if (n == 0) { break; }
+            fn(static_cast<const char*>(buffer.get()), static_cast<size_t>(n));
+        }
+    }
+
+#ifdef SELECT_K_HAS_IO_URING
+    // minimal io_uring (raw syscalls, no liburing) : one submission / completion ring pair
+    class Ring {
+    public:
+        static std::unique_ptr<Ring> create(unsigned entries) {
+            std::unique_ptr<Ring> ring(new Ring());
+            io_uring_params params {};
+            int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+            if (fd < 0) { return nullptr; }
+            ring->fd_ = fd;
+            ring->sqSize_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+            ring->cqSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                ring->sqSize_ = ring->cqSize_ = std::max(ring->sqSize_, ring->cqSize_);
+            }
+            ring->sq_ = ::mmap(nullptr, ring->sqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if (ring->sq_ == MAP_FAILED) { ring->sq_ = nullptr; return nullptr; }
+            if (params.features & IORING_FEAT_SINGLE_MMAP) {
+                ring->cq_ = ring->sq_;
+            } else {
+                ring->cq_ = ::mmap(nullptr, ring->cqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+                if (ring->cq_ == MAP_FAILED) { ring->cq_ = nullptr; return nullptr; }
+            }
+            ring->sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqes = ::mmap(nullptr, ring->sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) { return nullptr; }
+            ring->sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+            char* sq = static_cast<char*>(ring->sq_);
+            char* cq = static_cast<char*>(ring->cq_);
+            ring->sqTail_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+            ring->sqMask_ = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+            ring->sqArray_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+            ring->cqHead_ = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+            ring->cqTail_ = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+            ring->cqMask_ = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+            ring->cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            return ring;
+        }
+
+        ~Ring() {
+            if (sqes_ != nullptr) { ::munmap(sqes_, sqesSize_); }
+            if (cq_ != nullptr && cq_ != sq_) { ::munmap(cq_, cqSize_); }
+            if (sq_ != nullptr) { ::munmap(sq_, sqSize_); }
+            if (fd_ >= 0) { ::close(fd_); }
+        }
+
+        // queues a read (submitted with the next enter())
+        void prepareRead(int fd, char* data, size_t size, uint64_t offset, uint64_t userData) {
+            uint32_t tail = *sqTail_;
+            uint32_t index = tail & sqMask_;
+            io_uring_sqe& sqe = sqes_[index];
+            sqe = io_uring_sqe {};
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = fd;
+            sqe.addr = reinterpret_cast<uint64_t>(data);
+            sqe.len = static_cast<uint32_t>(size);
+            sqe.off = offset;
+            sqe.user_data = userData;
+            sqArray_[index] = index;
+            __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+            ++pending_;
+        }
+
+        // submits queued reads and waits for at least one completion, returns (user data, result)
+        std::pair<uint64_t, int> submitAndWait() {
+            for (;;) {
+                uint32_t head = *cqHead_;
+                if (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+                    const io_uring_cqe& cqe = cqes_[head & cqMask_];
+                    std::pair<uint64_t, int> completion { cqe.user_data, cqe.res };
+                    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+                    return completion;
+                }
+                int submitted = static_cast<int>(::syscall(__NR_io_uring_enter, fd_, pending_, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+                if (submitted < 0) {
+                    if (errno == EINTR) { continue; }
+                    throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+                }
+                pending_ -= static_cast<unsigned>(submitted);
+            }
+        }
+    private:
+        Ring() = default;
+
+        int fd_ = -1;
+        void* sq_ = nullptr;
+        void* cq_ = nullptr;
+        size_t sqSize_ = 0;
+        size_t cqSize_ = 0;
+        size_t sqesSize_ = 0;
+        io_uring_sqe* sqes_ = nullptr;
+        uint32_t* sqTail_ = nullptr;
+        uint32_t sqMask_ = 0;
+        uint32_t* sqArray_ = nullptr;
+        uint32_t* cqHead_ = nullptr;
+        uint32_t* cqTail_ = nullptr;
+        uint32_t cqMask_ = 0;
+        io_uring_cqe* cqes_ = nullptr;
+        unsigned pending_ = 0;
+    };
+
+    template <typename BlockFunction>
+    void readUring(BlockFunction& fn) {
+        // O_DIRECT bypasses the page cache for files that will not fit in it anyway, not every file system allows it
+        int directFd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+        int fd = directFd >= 0 ? directFd : fd_;
+        struct Slot {
+            Buffer buffer;
+            int result = 0;
+            bool done = false;
+        };
+        const uint64_t blocks = (size_ + blockSize_ - 1) / blockSize_;
+        std::vector<Slot> slots(queueDepth_);
+        uint64_t submitted = 0;
+        auto submit = [&](uint64_t block) {
+            Slot& slot = slots[block % queueDepth_];
+            if (!slot.buffer) { slot.buffer = allocate(); }
+            slot.done = false;
+            // O_DIRECT needs aligned lengths too : the last block is read as a full block, the kernel stops at EOF
+            uring_->prepareRead(fd, slot.buffer.get(), blockSize_, block * blockSize_, block);
+        };
+        try {
+            for (; submitted < blocks && submitted < queueDepth_; ++submitted) {
+                submit(submitted);
+            }
+            for (uint64_t next = 0; next < blocks; ++next) {
+                Slot& slot = slots[next % queueDepth_];
+                while (!slot.done) {
+                    auto [block, result] = uring_->submitAndWait();
+                    Slot& completed = slots[block % queueDepth_];
+                    completed.result = result;
+                    completed.done = true;
+                }
+                if (slot.result < 0) {
+                    if (next == 0 && (slot.result == -EINVAL || slot.result == -EOPNOTSUPP)) {
+                        // the ring was set up but this kernel / file system cannot read the file through it (e.g.
+                        // IORING_OP_READ missing before 5.6, or O_DIRECT refused) : nothing was delivered yet, so
+                        // drop the ring for good and read the whole file with pread()
+                        drain(slots);
+                        uring_.reset();
+                        break;
+                    }
+                    throw std::system_error(-slot.result, std::generic_category(), "io_uring read " + path_);
+                }
+                const uint64_t offset = next * blockSize_;
+                const size_t expected = static_cast<size_t>(std::min<uint64_t>(blockSize_, size_ - offset));
+                size_t got = static_cast<size_t>(slot.result);
+                if (got < expected) {
+                    // short read : finish the block synchronously through the buffered descriptor
+                    got += readFully(fd_, slot.buffer.get() + got, offset + got, expected - got);
+                }
+                fn(static_cast<const char*>(slot.buffer.get()), std::min(got, expected));
+                if (submitted < blocks) {
+                    submit(submitted++);
+                }
+            }
+        } catch (...) {
+            drain(slots);
+            if (directFd >= 0) { ::close(directFd); }
+            throw;
+        }
+        if (directFd >= 0) { ::close(directFd); }
+        if (uring_ == nullptr) {
+            readPread(fn);
+        }
+    }
+
+    // waits for reads still in flight (their buffers must outlive them)
+    template <typename Slots>
+    void drain(Slots& slots) {
+        size_t inFlight = 0;
+        for (const auto& slot : slots) {
+            if (slot.buffer && !slot.done) { ++inFlight; }
+        }
+        while (inFlight-- > 0) {
+            try {
+                uring_->submitAndWait();
+            } catch (...) {
+                return;
+            }
+        }
+    }
+
+    std::unique_ptr<Ring> uring_;
+#endif
+
+    std::string path_;
+    size_t blockSize_;
+    unsigned queueDepth_;
+    int fd_ = -1;
+    uint64_t size_ = 0;
+    bool regular_ = true;
+};
+
+}
+}
@@ -0,0 +1,324 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : IVF (inverted file) index - k-means partitioned approximate nearest neighbours
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      k::IvfOptions options;                  // lists (0 = 4 * sqrt(count)), nprobe, training settings
+ *      k::Ivf index(base.data(), count, dim, k::Metric::L2, options);
+ *      index.build();                          // trains the centroids and copies the rows into their lists
+ *
+ *      std::vector<k::Ivf::Neighbor> neighbors;               // (row, squared distance or similarity), nearest first
+ *      index.search(std::back_inserter(neighbors), query, 10, 16);     // probe the 16 nearest lists
+ *
+ *      auto results = index.searchBatch(queries.data(), queryCount, 10);
+ *      index.search(std::back_inserter(neighbors), query, 10, 0, k::Filter(allowed));   // allow-list (select_k_filter.h)
+ *
+ *  build() trains lists coarse centroids with k::KMeans (select_k_kmeans.h), then stores every row in the list of
+ *  its nearest centroid : the rows of a list are copied contiguously (normalized for Metric::Cosine) along with
+ *  their row ids, so probing a list is one sequential block scan with the SIMD kernels. A query picks its nprobe
+ *  nearest centroids, and the candidates of all probed lists go through one bounded k::Bottom style selector
+ *  (similarities are negated into distances). nprobe trades recall for speed; nprobe = lists is an exact scan.
+ *  searchBatch finds the lists of a whole batch with the tiled k::Nearest::searchBatch and scans in parallel.
+ *  A filtered search only scores the list rows the filter allows. Past nprobe it keeps probing every list that
+ *  could still hold a row nearer than its K-th allowed one (a lower bound from the list's radius around its
+ *  centroid), so the rows a filter pushes out of the nearest lists are still found. A filter allowing no more rows
+ *  than nprobe lists hold on average is answered with an exact scan of the allowed rows instead.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include "select_k/select_k_filter.h"
+#include "select_k/select_k_kmeans.h"
+#include "select_k/select_k_vector.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+namespace k {
+
+struct IvfOptions {
+    size_t lists = 0;                   // coarse centroids, 0 = 4 * sqrt(count)
+    size_t nprobe = 8;                  // default lists probed per query
+    size_t threads = 0;                 // training, bucketing and searchBatch threads, 0 = one per core
+    KMeansOptions kmeans;               // (kmeans.threads is taken from threads)
+};
+
+class Ivf {
+public:
+    // (row index, score) - squared distance for Metric::L2, similarity otherwise (as k::Nearest)
+    using Neighbor = std::pair<size_t, float>;
+    // candidates by distance (similarities are negated)
+    using Selector = Select<size_t, float, std::less<float>>;
+
+    // list rows scored in one kernel call
+    static constexpr size_t kBlock = 256;
+
+    // an empty index over the count rows of data (nothing is searchable until build())
+    Ivf(const float* data, size_t count, size_t dim, Metric metric = Metric::L2, IvfOptions options = {})
+        : data_(data), count_(count), dim_(dim), metric_(metric), options_(options) {
+        if (options_.lists == 0) {
+            options_.lists = std::max<size_t>(1, static_cast<size_t>(4 * std::sqrt(double(count_))));
+        }
+        options_.lists = std::max<size_t>(1, std::min(options_.lists, std::max<size_t>(1, count_)));
+        options_.kmeans.threads = options_.threads;
+    }
+
+    size_t count() const { return count_; }
+    size_t dim() const { return dim_; }
+    Metric metric() const { return metric_; }
+    size_t lists() const { return options_.lists; }
+    size_t listSize(size_t list) const { return listStart_[list + 1] - listStart_[list]; }
+    const float* centroid(size_t list) const { return centroids_.data() + list * dim_; }
+
+    void build() {
+        const size_t lists = options_.lists;
+        // L2 trains on the caller's rows; Cosine normalizes them once into vectors_, trains there and then permutes
+        // vectors_ into list order in place, so neither keeps a second copy of the dataset
+        const float* rows = data_;
+        if (metric_ == Metric::Cosine) {
+            vectors_.assign(data_, data_ + count_ * dim_);
+            simd::normalize(vectors_.data(), count_, dim_);
+            rows = vectors_.data();
+        }
+        centroids_ = KMeans::train(rows, count_, dim_, lists, options_.kmeans);
+        std::vector<uint32_t> assignment(count_);
+        KMeans::assign(rows, count_, dim_, centroids_.data(), lists, assignment.data(), options_.threads);
+
+        // counting sort of the rows by list
+        listStart_.assign(lists + 1, 0);
+        for (uint32_t list : assignment) {
+            ++listStart_[list + 1];
+        }
+        for (size_t list = 0; list < lists; ++list) {
+            listStart_[list + 1] += listStart_[list];
+        }
+        std::vector<size_t> next(listStart_.begin(), listStart_.end() - 1);
+        ids_.resize(count_);
+        positions_.resize(count_);
+        radius_.assign(lists, 0.0f);
+        for (size_t i = 0; i < count_; ++i) {
+            const size_t position = next[assignment[i]]++;
+            ids_[position] = i;
+            positions_[i] = position;
+            const float gap = std::sqrt(simd::squaredL2(rows + i * dim_, centroid(assignment[i]), dim_));
+            radius_[assignment[i]] = std::max(radius_[assignment[i]], gap);
+        }
+        if (metric_ == Metric::Cosine) {
+            permute();
+        } else {
+            vectors_.resize(count_ * dim_);
+            for (size_t i = 0; i < count_; ++i) {
+                std::copy(data_ + i * dim_, data_ + (i + 1) * dim_, vectors_.begin() + positions_[i] * dim_);
+            }
+        }
+        coarse_ = std::make_unique<Nearest>(centroids_.data(), lists, dim_, metric_ == Metric::L2 ? Metric::L2 : Metric::InnerProduct);
+    }
+
+    /**
+     * the (approximate) K nearest rows to query from the nprobe (0 = options.nprobe) nearest lists, nearest first
+     * with a filter only allowed rows are returned, lists past nprobe are probed while they can hold a nearer one
+     */
+    template <typename OutputIterator>
+    size_t search(OutputIterator out, const float* query, size_t k, size_t nprobe = 0, const Filter& filter = {}) const {
+        if (k == 0 || !coarse_) { return 0; }
+        std::vector<float> prepared;
+        query = prepare(query, prepared);
+        if (selective(filter, nprobe)) {
+            return results(out, scanAllowed(query, k, filter));
+        }
+        std::vector<Nearest::Neighbor> probes;
+        coarse_->search(std::back_inserter(probes), query, filter.all() ? probeCount(nprobe) : options_.lists);
+        return results(out, scan(query, probes, k, probeCount(nprobe), filter));
+    }
+
+    /**
+     * the (approximate) K nearest rows to each of queryCount queries (row major) : results[q] is nearest first
+     * threads = 0 uses options.threads
+     */
+    std::vector<std::vector<Neighbor>> searchBatch(const float* queries, size_t queryCount, size_t k, size_t nprobe = 0,
+                                                   size_t threads = 0, const Filter& filter = {}) const {
+        std::vector<std::vector<Neighbor>> neighbors(queryCount);
+        if (k == 0 || !coarse_ || queryCount == 0) { return neighbors; }
+        std::vector<float> prepared;
+        if (metric_ == Metric::Cosine) {
+            prepared.assign(queries, queries + queryCount * dim_);
+            simd::normalize(prepared.data(), queryCount, dim_);
+            queries = prepared.data();
+        }
+        threads = threads == 0 ? options_.threads : threads;
+        const bool exact = selective(filter, nprobe);
+        std::vector<std::vector<Nearest::Neighbor>> probes;
+        if (!exact) {
+            probes = coarse_->searchBatch(queries, queryCount, filter.all() ? probeCount(nprobe) : options_.lists, threads);
+        }
+        if (threads == 0) {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        KMeans::forEachChunk(queryCount, std::min(threads, queryCount), [&](size_t, size_t begin, size_t end) {
+            for (size_t q = begin; q < end; ++q) {
+                const float* query = queries + q * dim_;
+                results(std::back_inserter(neighbors[q]),
+                        exact ? scanAllowed(query, k, filter) : scan(query, probes[q], k, probeCount(nprobe), filter));
+            }
+        });
+        return neighbors;
+    }
+
+protected:
+    // moves row i of vectors_ to positions_[i], one cycle of the permutation at a time through a single row buffer
+    void permute() {
+        std::vector<bool> placed(count_, false);
+        std::vector<float> held(dim_);
+        for (size_t start = 0; start < count_; ++start) {
+            if (placed[start]) { continue; }
+            std::copy(vectors_.begin() + start * dim_, vectors_.begin() + (start + 1) * dim_, held.begin());
+            // held is row's vector; its slot still holds the vector of the row with that index until swapped
+            for (size_t row = start; !placed[row];) {
+                placed[row] = true;
+                const size_t position = positions_[row];
+                std::swap_ranges(held.begin(), held.end(), vectors_.begin() + position * dim_);
+                row = position;
+            }
+        }
+    }
+
+    size_t probeCount(size_t nprobe) const {
+        return std::min(nprobe == 0 ? options_.nprobe : nprobe, options_.lists);
+    }
+
+    // a filter allowing no more rows than nprobe lists hold on average is cheaper to scan exactly than to probe
+    bool selective(const Filter& filter, size_t nprobe) const {
+        return !filter.all() && filter.count(count_) <= probeCount(nprobe) * count_ / options_.lists;
+    }
+
+    // the query as compared against the lists (a unit length copy in prepared for Metric::Cosine)
+    const float* prepare(const float* query, std::vector<float>& prepared) const {
+        if (metric_ != Metric::Cosine) { return query; }
+        prepared.assign(query, query + dim_);
+        simd::normalize(prepared.data(), 1, dim_);
+        return prepared.data();
+    }
+
+    // distance (smaller is nearer) from a prepared query to the row at a list position
+    float distance(const float* query, size_t position) const {
+        const float* row = vectors_.data() + position * dim_;
+        return metric_ == Metric::L2 ? simd::squaredL2(query, row, dim_) : -simd::dot(query, row, dim_);
+    }
+
+    // lower bound of the distance from a prepared query to the rows of a probed list (centroid score, list radius)
+    float bound(const Nearest::Neighbor& probe, float queryNorm) const {
+        const float radius = radius_[probe.first];
+        if (metric_ == Metric::L2) {
+            const float gap = std::max(0.0f, std::sqrt(probe.second) - radius);
+            return gap * gap;
+        }
+        // dot(q, row) <= dot(q, centroid) + |q| * |row - centroid|
+        return -(probe.second + queryNorm * radius);
+    }
+
+    /**
+     * selector of list positions over the first nprobe probes
+     * with a filter (probes then holds every list) the later lists are scanned too, unless the selector is full and
+     * their bound shows none of their rows can beat its threshold
+     */
+    Selector scan(const float* query, const std::vector<Nearest::Neighbor>& probes, size_t k, size_t nprobe,
+                  const Filter& filter) const {
+        Selector selector(k, [this, query](const size_t& position) { return distance(query, position); });
+        float scores[kBlock];
+        const float queryNorm = metric_ == Metric::L2 || filter.all() ? 0.0f : std::sqrt(simd::dot(query, query, dim_));
+        for (size_t p = 0; p < probes.size(); ++p) {
+            const auto& probe = probes[p];
+            if (p >= nprobe && selector.full() && bound(probe, queryNorm) >= selector.threshold()) { continue; }
+            const size_t end = listStart_[probe.first + 1];
+            if (!filter.all()) {
+                // list rows are not in row order : one bit test per row, only allowed rows are scored
+                for (size_t position = listStart_[probe.first]; position < end; ++position) {
+                    if (!filter.allows(ids_[position])) { continue; }
+                    const float d = distance(query, position);
+                    if (!selector.full() || d < selector.threshold()) {
+                        selector.offerScored(position, d);
+                    }
+                }
+                continue;
+            }
+            for (size_t first = listStart_[probe.first]; first < end; first += kBlock) {
+                const size_t rows = std::min(kBlock, end - first);
+                const float* block = vectors_.data() + first * dim_;
+                if (metric_ == Metric::L2) {
+                    simd::squaredL2Block(query, block, rows, dim_, scores);
+                } else {
+                    simd::dotBlock(query, block, rows, dim_, scores);
+                    for (size_t i = 0; i < rows; ++i) {
+                        scores[i] = -scores[i];
+                    }
+                }
+                for (size_t i = 0; i < rows; ++i) {
+                    if (!selector.full() || scores[i] < selector.threshold()) {
+                        selector.offerScored(first + i, scores[i]);
+                    }
+                }
+            }
+        }
+        return selector;
+    }
+
+    // exact scan of the rows filter allows (for filters too selective to be worth probing lists)
+    Selector scanAllowed(const float* query, size_t k, const Filter& filter) const {
+        Selector selector(k, [this, query](const size_t& position) { return distance(query, position); });
+        filter.forEach(count_, [&](size_t row) {
+            const size_t position = positions_[row];
+            const float d = distance(query, position);
+            if (!selector.full() || d < selector.threshold()) {
+                selector.offerScored(position, d);
+            }
+        });
+        return selector;
+    }
+
+    template <typename OutputIterator>
+    size_t results(OutputIterator out, const Selector& selector) const {
+        std::vector<std::pair<size_t, float>> found;
+        found.reserve(selector.size());
+        selector.scoredResults(std::back_inserter(found), true);
+        for (auto [position, distance] : found) {
+            *out++ = Neighbor(ids_[position], metric_ == Metric::L2 ? distance : -distance);
+        }
+        return found.size();
+    }
+
+    const float* data_;
+    size_t count_;
+    size_t dim_;
+    Metric metric_;
+    IvfOptions options_;
+
+    std::vector<float> centroids_;
+    std::unique_ptr<Nearest> coarse_;
+    std::vector<size_t> listStart_;
+    std::vector<size_t> ids_;
+    std::vector<size_t> positions_;     // list position of each row
+    std::vector<float> radius_;         // largest distance from a list's centroid to its rows
+    std::vector<float> vectors_;
+};
+
+}
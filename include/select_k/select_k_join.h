@@ -0,0 +1,190 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : exact all-k-nearest-neighbours self join (the k-NN graph of a set of vectors)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      // graph[i] = the 10 nearest other rows of row i, nearest first (as k::Nearest::Neighbor)
+ *      auto graph = k::AllNearest::compute(base.data(), count, dim, 10);
+ *
+ *  Rows are cut into blocks of kBlock rows. Every pair of blocks (a, b) is scored once as a simd::dotTile tile and
+ *  each distance in it is offered to both endpoints' selectors (row i gets j, row j gets i), so the join computes
+ *  N^2 / 2 distances instead of the N^2 of N separate searches, and a tile's two blocks stay in cache while it runs.
+ *
+ *  Each row's selector is only ever touched by one thread at a time without locks : block pairs are scheduled as
+ *  a round robin tournament (the circle method), where the pairs of one round never share a block. Threads take
+ *  the pairs of a round from a shared counter and meet at a barrier before the next round. The diagonal tiles
+ *  (a, a) form round 0. Squared L2 distances come from ||x||^2 + ||y||^2 - 2 x.y and the final K are re-scored
+ *  exactly (as in k::Nearest::searchBatch).
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include "select_k/select_k_kmeans.h"
+#include "select_k/select_k_vector.h"
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <thread>
+#include <vector>
+namespace k {
+
+class AllNearest {
+public:
+    // (row index, score) - squared distance for Metric::L2, similarity otherwise (as k::Nearest)
+    using Neighbor = Nearest::Neighbor;
+    // a row's nearest rows so far, by distance (similarities are negated)
+    using Selector = Select<size_t, float, std::less<float>>;
+
+    // rows per block : a tile is kBlock x kBlock scores
+    static constexpr size_t kBlock = 128;
+
+    /**
+     * the K nearest other rows of every one of the count rows of data : graph[i] is nearest first
+     * threads = 0 uses one thread per core
+     */
+    static std::vector<std::vector<Neighbor>> compute(const float* data, size_t count, size_t dim, size_t k,
+                                                      Metric metric = Metric::L2, size_t threads = 0) {
+        std::vector<std::vector<Neighbor>> graph(count);
+        if (count == 0 || k == 0) { return graph; }
+        std::vector<float> normalized;
+        if (metric == Metric::Cosine) {
+            normalized.assign(data, data + count * dim);
+            simd::normalize(normalized.data(), count, dim);
+            data = normalized.data();
+        }
+        std::vector<float> norms;
+        if (metric == Metric::L2) {
+            norms.resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                norms[i] = simd::dot(data + i * dim, data + i * dim, dim);
+            }
+        }
+        auto distance = [data, dim, metric](size_t a, size_t b) {
+            return metric == Metric::L2 ? simd::squaredL2(data + a * dim, data + b * dim, dim)
+                                        : -simd::dot(data + a * dim, data + b * dim, dim);
+        };
+        std::vector<Selector> selectors;
+        selectors.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            selectors.emplace_back(k, [&distance, i](const size_t& j) { return distance(i, j); });
+        }
+
+        const std::vector<std::vector<std::pair<size_t, size_t>>> rounds = schedule((count + kBlock - 1) / kBlock);
+        threads = KMeans::threadCount(threads, count);
+        std::vector<std::atomic<size_t>> next(rounds.size());
+        std::barrier<> roundEnd(static_cast<std::ptrdiff_t>(threads));
+        auto work = [&]() {
+            std::vector<float> tile(kBlock * kBlock);
+            for (size_t round = 0; round < rounds.size(); ++round) {
+                for (size_t pair = next[round]++; pair < rounds[round].size(); pair = next[round]++) {
+                    joinBlocks(data, dim, norms, rounds[round][pair].first, rounds[round][pair].second, count, tile, selectors);
+                }
+                roundEnd.arrive_and_wait();
+            }
+        };
+        if (threads == 1) {
+            work();
+        } else {
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (size_t worker = 0; worker < threads; ++worker) {
+                workers.emplace_back(work);
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+
+        KMeans::forEachChunk(count, threads, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                std::vector<Neighbor>& neighbors = graph[i];
+                selectors[i].scoredResults(std::back_inserter(neighbors), true);
+                if (metric == Metric::L2) {
+                    for (auto& neighbor : neighbors) {
+                        neighbor.second = distance(i, neighbor.first);
+                    }
+                    std::stable_sort(neighbors.begin(), neighbors.end(),
+                                     [](const Neighbor& a, const Neighbor& b) { return a.second < b.second; });
+                } else {
+                    for (auto& neighbor : neighbors) {
+                        neighbor.second = -neighbor.second;
+                    }
+                }
+            }
+        });
+        return graph;
+    }
+
+    /**
+     * block pairs of a self join of blocks blocks : round 0 holds the diagonal (a, a), then one round robin round per
+     * line of the circle method (an odd block count gets a dummy block, whose pairs are dropped). No two pairs of a
+     * round share a block, and every a < b pair appears exactly once.
+     */
+    static std::vector<std::vector<std::pair<size_t, size_t>>> schedule(size_t blocks) {
+        std::vector<std::vector<std::pair<size_t, size_t>>> rounds(1);
+        for (size_t a = 0; a < blocks; ++a) {
+            rounds[0].emplace_back(a, a);
+        }
+        const size_t teams = blocks + blocks % 2;
+        for (size_t round = 0; round + 1 < teams; ++round) {
+            std::vector<std::pair<size_t, size_t>> pairs;
+            for (size_t i = 0; i < teams / 2; ++i) {
+                // team teams - 1 stays put, the others rotate one seat per round
+                size_t a = (round + i) % (teams - 1);
+                size_t b = i == 0 ? teams - 1 : (round + teams - 1 - i) % (teams - 1);
+                if (a < blocks && b < blocks) {
+                    pairs.emplace_back(std::min(a, b), std::max(a, b));
+                }
+            }
+            rounds.push_back(std::move(pairs));
+        }
+        return rounds;
+    }
+
+private:
+    // scores block a against block b once and offers every distance to both rows
+    static void joinBlocks(const float* data, size_t dim, const std::vector<float>& norms, size_t a, size_t b,
+                           size_t count, std::vector<float>& tile, std::vector<Selector>& selectors) {
+        const size_t firstA = a * kBlock;
+        const size_t firstB = b * kBlock;
+        const size_t rowsA = std::min(kBlock, count - firstA);
+        const size_t rowsB = std::min(kBlock, count - firstB);
+        simd::dotTile(data + firstA * dim, rowsA, data + firstB * dim, rowsB, dim, tile.data());
+        for (size_t i = 0; i < rowsA; ++i) {
+            Selector& left = selectors[firstA + i];
+            const float* scores = tile.data() + i * rowsB;
+            // a diagonal tile only uses its upper triangle
+            for (size_t j = a == b ? i + 1 : 0; j < rowsB; ++j) {
+                const float d = norms.empty() ? -scores[j] : std::max(0.0f, norms[firstA + i] + norms[firstB + j] - 2 * scores[j]);
+                if (!left.full() || d < left.threshold()) {
+                    left.offerScored(firstB + j, d);
+                }
+                Selector& right = selectors[firstB + j];
+                if (!right.full() || d < right.threshold()) {
+                    right.offerScored(firstA + i, d);
+                }
+            }
+        }
+    }
+};
+
+}
@@ -0,0 +1,280 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : KD-tree for exact k-nearest neighbours over low dimensional points
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      // points : count x dim coordinates, row major (copied into the tree)
+ *      k::KdTree<int> tree(points.data(), count, 2);
+ *
+ *      std::vector<k::KdTree<int>::Neighbor> neighbors;   // (point index, squared distance), nearest first
+ *      tree.search(std::back_inserter(neighbors), query, 4);
+ *
+ *      // pagination : neighbours one page at a time, nearest first, each page resuming where the last one stopped
+ *      auto cursor = tree.nearest(query);
+ *      cursor.next(std::back_inserter(page), 10);      // neighbours 1 .. 10
+ *      cursor.next(std::back_inserter(page), 10);      // neighbours 11 .. 20
+ *
+ *  The tree is implicit : points are stored in tree order in one contiguous array and the node covering positions
+ *  [begin, end) splits at its median position mid = begin + (end - begin) / 2, so only the split axis of each node
+ *  is stored (at axes_[mid]). Subtrees of at most kLeafSize points are scanned linearly. The build splits each node
+ *  on its widest axis with std::nth_element, handing the left half of the top levels to other threads.
+ *
+ *  Queries descend to the nearer child first and visit the farther child only while the selector is not full or
+ *  the squared distance to the splitting plane beats the selector's current threshold (the K-th best distance).
+ *
+ *  nearest() returns a Cursor doing a best-first traversal instead : one priority queue holds both points (keyed by
+ *  their distance) and unvisited subtrees (keyed by a lower bound - the larger of the parent's bound and the squared
+ *  distance to the splitting plane on the far side). A point popped off the queue is nearer than anything still
+ *  queued, so neighbours come out in distance order and fetching the next page only expands what it needs.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+namespace k {
+
+template <typename CoordinateType = float>
+class KdTree {
+public:
+    using Coordinate = CoordinateType;
+    // squared distances of integer points are accumulated exactly in 64 bits
+    using Distance = std::conditional_t<std::is_floating_point_v<Coordinate>, Coordinate, int64_t>;
+    // (point index in the input, squared distance)
+    using Neighbor = std::pair<size_t, Distance>;
+    // selects tree positions (see search())
+    using Selector = Select<size_t, Distance, std::less<Distance>>;
+
+    static constexpr size_t kLeafSize = 16;
+
+    /**
+     * builds the tree over count points of dim coordinates (row major), threads = 0 uses one thread per core
+     */
+    KdTree(const Coordinate* data, size_t count, size_t dim, size_t threads = 0)
+        : dim_(dim), ids_(count), axes_(count, 0), points_(count * dim) {
+        for (size_t i = 0; i < count; ++i) {
+            ids_[i] = i;
+        }
+        if (threads == 0) {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        size_t parallelDepth = 0;
+        while ((size_t(1) << parallelDepth) < threads) {
+            ++parallelDepth;
+        }
+        build(data, 0, count, parallelDepth);
+        for (size_t i = 0; i < count; ++i) {
+            std::copy(data + ids_[i] * dim_, data + (ids_[i] + 1) * dim_, points_.begin() + i * dim_);
+        }
+    }
+
+    size_t count() const { return ids_.size(); }
+    size_t dim() const { return dim_; }
+
+    // the K nearest points to query as Neighbor (index, squared distance), nearest first
+    template <typename OutputIterator>
+    size_t search(OutputIterator out, const Coordinate* query, size_t k) const {
+        Selector selector = select(query, k);
+        std::vector<std::pair<size_t, Distance>> positions;
+        positions.reserve(selector.size());
+        selector.scoredResults(std::back_inserter(positions), true);
+        for (auto [position, distance] : positions) {
+            *out++ = Neighbor(ids_[position], distance);
+        }
+        return positions.size();
+    }
+
+    // selector of tree positions (map with id()) holding the K nearest points to query
+    Selector select(const Coordinate* query, size_t k) const {
+        Selector selector(k, [this, query](const size_t& position) { return distance(query, position); });
+        if (k > 0) {
+            search(selector, query, 0, count());
+        }
+        return selector;
+    }
+
+    /**
+     * best-first neighbour iterator over a tree (which must outlive it) : next() yields the nearest points not yet
+     * returned, so any number of results can be fetched incrementally
+     */
+    class Cursor {
+    public:
+        Cursor(const KdTree& tree, const Coordinate* query) : tree_(tree), query_(query, query + tree.dim()) {
+            if (tree_.count() > 0) {
+                queue_.push(Entry{ 0, true, 0, tree_.count() });
+            }
+        }
+
+        // the next nearest point, false once every point was returned
+        bool next(Neighbor& neighbor) {
+            while (!queue_.empty()) {
+                Entry entry = queue_.top();
+                queue_.pop();
+                if (!entry.node) {
+                    neighbor = Neighbor(tree_.id(entry.begin), entry.distance);
+                    return true;
+                }
+                expand(entry);
+            }
+            return false;
+        }
+
+        // up to n more neighbours, nearest first, returns how many were written
+        template <typename OutputIterator>
+        size_t next(OutputIterator out, size_t n) {
+            size_t written = 0;
+            Neighbor neighbor;
+            while (written < n && next(neighbor)) {
+                *out++ = neighbor;
+                ++written;
+            }
+            return written;
+        }
+
+    private:
+        // a point (its tree position in begin) at its distance, or a subtree [begin, end) at a lower bound
+        struct Entry {
+            Distance distance;
+            bool node;
+            size_t begin;
+            size_t end;
+
+            // nearer first; at equal keys points come out before subtrees
+            bool operator>(const Entry& other) const {
+                return distance != other.distance ? distance > other.distance : node > other.node;
+            }
+        };
+
+        void expand(const Entry& entry) {
+            if (entry.end - entry.begin <= kLeafSize) {
+                for (size_t position = entry.begin; position < entry.end; ++position) {
+                    queue_.push(Entry{ tree_.distance(query_.data(), position), false, position, position + 1 });
+                }
+                return;
+            }
+            const size_t mid = entry.begin + (entry.end - entry.begin) / 2;
+            const size_t axis = tree_.axes_[mid];
+            const Distance diff = Distance(query_[axis]) - Distance(tree_.point(mid)[axis]);
+            const Distance far = std::max(entry.distance, diff * diff);
+            queue_.push(Entry{ tree_.distance(query_.data(), mid), false, mid, mid + 1 });
+            // points equal to the split coordinate may lie on either side, so the left side is only "far" when diff > 0
+            queue_.push(Entry{ diff <= 0 ? entry.distance : far, true, entry.begin, mid });
+            queue_.push(Entry{ diff >= 0 ? entry.distance : far, true, mid + 1, entry.end });
+        }
+
+        const KdTree& tree_;
+        std::vector<Coordinate> query_;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue_;
+    };
+
+    // a best-first iterator over the points nearest to query (query is copied)
+    Cursor nearest(const Coordinate* query) const { return Cursor(*this, query); }
+
+    // input index of the point at a tree position
+    size_t id(size_t position) const { return ids_[position]; }
+    const Coordinate* point(size_t position) const { return points_.data() + position * dim_; }
+
+    Distance distance(const Coordinate* query, size_t position) const {
+        const Coordinate* p = point(position);
+        Distance sum = 0;
+        for (size_t i = 0; i < dim_; ++i) {
+            Distance d = Distance(query[i]) - Distance(p[i]);
+            sum += d * d;
+        }
+        return sum;
+    }
+
+protected:
+    void build(const Coordinate* data, size_t begin, size_t end, size_t parallelDepth) {
+        if (end - begin <= kLeafSize) { return; }
+        // split on the axis with the widest spread
+        size_t axis = 0;
+        Coordinate widest = 0;
+        for (size_t d = 0; d < dim_; ++d) {
+            Coordinate low = data[ids_[begin] * dim_ + d];
+            Coordinate high = low;
+            for (size_t i = begin + 1; i < end; ++i) {
+                Coordinate c = data[ids_[i] * dim_ + d];
+                low = std::min(low, c);
+                high = std::max(high, c);
+            }
+            if (high - low > widest) {
+                widest = high - low;
+                axis = d;
+            }
+        }
+        const size_t mid = begin + (end - begin) / 2;
+        std::nth_element(ids_.begin() + begin, ids_.begin() + mid, ids_.begin() + end,
+                         [data, axis, this](size_t a, size_t b) { return data[a * dim_ + axis] < data[b * dim_ + axis]; });
+        axes_[mid] = static_cast<uint32_t>(axis);
+        if (parallelDepth > 0) {
+            std::thread left([this, data, begin, mid, parallelDepth]() { build(data, begin, mid, parallelDepth - 1); });
+            build(data, mid + 1, end, parallelDepth - 1);
+            left.join();
+        } else {
+            build(data, begin, mid, 0);
+            build(data, mid + 1, end, 0);
+        }
+    }
+
+    void search(Selector& selector, const Coordinate* query, size_t begin, size_t end) const {
+        if (end - begin <= kLeafSize) {
+            for (size_t position = begin; position < end; ++position) {
+                Distance d = distance(query, position);
+                if (!selector.full() || d < selector.threshold()) {
+                    selector.offerScored(position, d);
+                }
+            }
+            return;
+        }
+        const size_t mid = begin + (end - begin) / 2;
+        const size_t axis = axes_[mid];
+        const Distance diff = Distance(query[axis]) - Distance(point(mid)[axis]);
+        Distance d = distance(query, mid);
+        if (!selector.full() || d < selector.threshold()) {
+            selector.offerScored(mid, d);
+        }
+        // points equal to the split coordinate may lie on either side, so ties go left first
+        if (diff <= 0) {
+            search(selector, query, begin, mid);
+            if (!selector.full() || diff * diff < selector.threshold()) {
+                search(selector, query, mid + 1, end);
+            }
+        } else {
+            search(selector, query, mid + 1, end);
+            if (!selector.full() || diff * diff < selector.threshold()) {
+                search(selector, query, begin, mid);
+            }
+        }
+    }
+
+    size_t dim_;
+    std::vector<size_t> ids_;
+    std::vector<uint32_t> axes_;
+    std::vector<Coordinate> points_;
+};
+
+}
@@ -0,0 +1,202 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : k-means (Lloyd's) over dense float vectors, used to train vector quantizers
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      std::vector<float> centroids = k::KMeans::train(base.data(), count, dim, 256);   // 256 x dim floats
+ *
+ *      std::vector<uint32_t> assignment(count);
+ *      k::KMeans::assign(base.data(), count, dim, centroids.data(), 256, assignment.data());
+ *
+ *  Training runs on at most maxSamplesPerCentroid random rows per centroid. Centroids start as distinct random
+ *  rows; each iteration assigns rows to their nearest centroid (tiled SIMD dot products, one row chunk per
+ *  thread) and recomputes centroids from per-thread partial sums. A centroid left empty takes over half of the largest
+ *  cluster (its centroid nudged apart), so every centroid stays in use.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k_simd.h"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+namespace k {
+
+struct KMeansOptions {
+    size_t iterations = 20;
+    size_t maxSamplesPerCentroid = 256;     // training rows are subsampled beyond clusters * this
+    size_t threads = 0;                     // 0 = one per core
+    uint64_t seed = 1234;
+};
+
+class KMeans {
+public:
+    // clusters x dim centroids of the count rows of data (fewer rows than clusters repeat rows)
+    static std::vector<float> train(const float* data, size_t count, size_t dim, size_t clusters,
+                                    const KMeansOptions& options = {}) {
+        std::vector<float> centroids(clusters * dim, 0.0f);
+        if (count == 0 || clusters == 0) { return centroids; }
+        std::mt19937_64 random(options.seed);
+
+        // training sample
+        std::vector<size_t> rows(count);
+        std::iota(rows.begin(), rows.end(), size_t(0));
+        const size_t samples = std::min(count, std::max(clusters, clusters * options.maxSamplesPerCentroid));
+        for (size_t i = 0; i < samples; ++i) {
+            std::swap(rows[i], rows[i + random() % (count - i)]);
+        }
+        std::vector<float> sample(samples * dim);
+        for (size_t i = 0; i < samples; ++i) {
+            std::copy(data + rows[i] * dim, data + (rows[i] + 1) * dim, sample.begin() + i * dim);
+        }
+
+        // the first rows of the shuffled sample are distinct random rows
+        for (size_t c = 0; c < clusters; ++c) {
+            std::copy(sample.begin() + (c % samples) * dim, sample.begin() + (c % samples + 1) * dim, centroids.begin() + c * dim);
+        }
+
+        const size_t threads = threadCount(options.threads, samples);
+        std::vector<uint32_t> assignment(samples);
+        std::vector<std::vector<double>> sums(threads, std::vector<double>(clusters * dim));
+        std::vector<std::vector<size_t>> sizes(threads, std::vector<size_t>(clusters));
+        for (size_t iteration = 0; iteration < options.iterations; ++iteration) {
+            forEachChunk(samples, threads, [&](size_t chunk, size_t begin, size_t end) {
+                assignRange(sample.data(), begin, end, dim, centroids.data(), clusters, assignment.data());
+                std::vector<double>& sum = sums[chunk];
+                std::vector<size_t>& size = sizes[chunk];
+                std::fill(sum.begin(), sum.end(), 0.0);
+                std::fill(size.begin(), size.end(), 0);
+                for (size_t i = begin; i < end; ++i) {
+                    const uint32_t c = assignment[i];
+                    ++size[c];
+                    for (size_t d = 0; d < dim; ++d) {
+                        sum[c * dim + d] += sample[i * dim + d];
+                    }
+                }
+            });
+            std::vector<size_t> size(clusters, 0);
+            for (size_t c = 0; c < clusters; ++c) {
+                for (size_t t = 0; t < threads; ++t) {
+                    size[c] += sizes[t][c];
+                }
+                if (size[c] == 0) { continue; }
+                for (size_t d = 0; d < dim; ++d) {
+                    double sum = 0;
+                    for (size_t t = 0; t < threads; ++t) {
+                        sum += sums[t][c * dim + d];
+                    }
+                    centroids[c * dim + d] = static_cast<float>(sum / double(size[c]));
+                }
+            }
+            splitEmpty(centroids.data(), size, dim);
+        }
+        return centroids;
+    }
+
+    // out[i] = index of the centroid nearest (L2) to row i, rows are split over threads (0 = one per core)
+    static void assign(const float* data, size_t count, size_t dim, const float* centroids, size_t clusters, uint32_t* out,
+                       size_t threads = 0) {
+        if (clusters == 0) { return; }
+        forEachChunk(count, threadCount(threads, count), [&](size_t, size_t begin, size_t end) {
+            assignRange(data, begin, end, dim, centroids, clusters, out);
+        });
+    }
+
+    // runs fn(chunk, begin, end) over threads contiguous chunks of [0, count), one thread each
+    template <typename ChunkFunction>
+    static void forEachChunk(size_t count, size_t threads, ChunkFunction fn) {
+        if (threads <= 1) {
+            fn(0, 0, count);
+            return;
+        }
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (size_t chunk = 0; chunk < threads; ++chunk) {
+            workers.emplace_back(fn, chunk, count * chunk / threads, count * (chunk + 1) / threads);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    static size_t threadCount(size_t threads, size_t count) {
+        if (threads == 0) {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        return std::max<size_t>(1, std::min(threads, count / kMinRowsPerThread));
+    }
+
+private:
+    static constexpr size_t kMinRowsPerThread = 1024;
+    static constexpr size_t kAssignTile = 32;
+
+    // nearest centroid of rows [begin, end) : tiles of rows are scored against all centroids with simd::dotTile,
+    // ||x - c||^2 ranks as ||c||^2 - 2 x.c (||x||^2 is the same for every centroid)
+    static void assignRange(const float* data, size_t begin, size_t end, size_t dim, const float* centroids,
+                            size_t clusters, uint32_t* out) {
+        std::vector<float> norms(clusters);
+        for (size_t c = 0; c < clusters; ++c) {
+            norms[c] = simd::dot(centroids + c * dim, centroids + c * dim, dim);
+        }
+        std::vector<float> dots(kAssignTile * clusters);
+        for (size_t first = begin; first < end; first += kAssignTile) {
+            const size_t rows = std::min(kAssignTile, end - first);
+            simd::dotTile(data + first * dim, rows, centroids, clusters, dim, dots.data());
+            for (size_t i = 0; i < rows; ++i) {
+                const float* row = dots.data() + i * clusters;
+                uint32_t nearest = 0;
+                float best = norms[0] - 2 * row[0];
+                for (size_t c = 1; c < clusters; ++c) {
+                    float d = norms[c] - 2 * row[c];
+                    if (d < best) {
+                        best = d;
+                        nearest = static_cast<uint32_t>(c);
+                    }
+                }
+                out[first + i] = nearest;
+            }
+        }
+    }
+
+    // each empty cluster takes over half of the largest one : both centroids move a little apart
+    static void splitEmpty(float* centroids, std::vector<size_t>& size, size_t dim) {
+        for (size_t c = 0; c < size.size(); ++c) {
+            if (size[c] != 0) { continue; }
+            size_t largest = static_cast<size_t>(std::max_element(size.begin(), size.end()) - size.begin());
+            if (size[largest] < 2) { return; }
+            for (size_t d = 0; d < dim; ++d) {
+                float value = centroids[largest * dim + d];
+                float nudge = (value == 0.0f ? 1.0f : value) * kSplitEpsilon;
+                centroids[c * dim + d] = value + (d % 2 == 0 ? nudge : -nudge);
+                centroids[largest * dim + d] = value - (d % 2 == 0 ? nudge : -nudge);
+            }
+            size[c] = size[largest] / 2;
+            size[largest] -= size[c];
+        }
+    }
+
+    static constexpr float kSplitEpsilon = 1.0f / 1024;
+};
+
+}
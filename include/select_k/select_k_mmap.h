@@ -0,0 +1,244 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : top-k over memory-mapped files of fixed-width records (POSIX)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      k::MappedFile file("features.bin");
+ *      k::Records records(file, sizeof(Feature));
+ *
+ *      std::vector<size_t> best;
+ *      // score is a float stored at byte offset 8 of every record
+ *      k::TopRecords<float>::compute(std::back_inserter(best), k, records, 8);
+ *
+ *      // best holds record indices (byte offset = index * records.recordSize())
+ *
+ *  Records are scored in place, straight out of the mapping. Only admitted record indices are copied
+ *  into the selector. The file is scanned in contiguous chunks, one selector per thread, merged at the end.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <system_error>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+namespace k {
+
+// read-only memory mapping of a whole file, throws std::system_error if the file cannot be opened / mapped
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path, bool sequential = true) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "fstat " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "mmap " + path);
+            }
+            data_ = static_cast<const std::byte*>(mapped);
+            if (sequential) {
+                advise(MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+                advise(MADV_HUGEPAGE);
+#endif
+            }
+        }
+        ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept : data_(other.data_), size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    ~MappedFile() {
+        unmap();
+    }
+
+    const std::byte* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // madvise() hint for the whole mapping (hints are best effort, failures are ignored)
+    void advise(int advice) const {
+        if (data_ != nullptr) {
+            ::madvise(const_cast<std::byte*>(data_), size_, advice);
+        }
+    }
+
+    // madvise() hint for the bytes [offset, offset + length) (widened to whole pages)
+    void advise(int advice, size_t offset, size_t length) const {
+        if (data_ == nullptr || offset >= size_) { return; }
+        const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        const size_t begin = offset / page * page;
+        const size_t end = std::min(size_, offset + length);
+        ::madvise(const_cast<std::byte*>(data_) + begin, end - begin, advice);
+    }
+private:
+    void unmap() {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<std::byte*>(data_), size_);
+            data_ = nullptr;
+        }
+    }
+
+    const std::byte* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// a record inside the mapping (no copy)
+struct RecordView {
+    const std::byte* data;
+    size_t size;
+    size_t index;
+
+    size_t offset() const { return index * size; }
+
+    template <typename Field>
+    Field field(size_t fieldOffset) const {
+        static_assert(std::is_trivially_copyable_v<Field>, "record fields must be trivially copyable");
+        Field value;
+        std::memcpy(&value, data + fieldOffset, sizeof(Field));
+        return value;
+    }
+};
+
+// a mapped file viewed as an array of fixed-width records (a trailing partial record is ignored)
+class Records {
+public:
+    Records(const MappedFile& file, size_t recordSize)
+        : data_(file.data()), recordSize_(recordSize), count_(recordSize == 0 ? 0 : file.size() / recordSize) {}
+
+    size_t count() const { return count_; }
+    size_t recordSize() const { return recordSize_; }
+    RecordView record(size_t index) const {
+        return RecordView { data_ + index * recordSize_, recordSize_, index };
+    }
+private:
+    const std::byte* data_;
+    size_t recordSize_;
+    size_t count_;
+};
+
+template <typename ScoreType, class CompareType>
+class SelectRecords {
+public:
+    using Selector = Select<size_t, ScoreType, CompareType>;
+    using RecordScoringFunction = std::function<ScoreType(const RecordView&)>;
+
+    // below this many records per thread, scanning is not worth a thread
+    static constexpr size_t kMinRecordsPerThread = 1 << 16;
+
+    /**
+     * score is the ScoreType field stored at scoreOffset in every record
+     * throws std::invalid_argument if the field does not fit inside a record
+     */
+    template <typename OutputIterator>
+    static size_t compute(OutputIterator out, size_t k, const Records& records, size_t scoreOffset, size_t threads = 0) {
+        if (scoreOffset > records.recordSize() || sizeof(ScoreType) > records.recordSize() - scoreOffset) {
+            throw std::invalid_argument("score field at offset " + std::to_string(scoreOffset) + " does not fit in a " +
+                                        std::to_string(records.recordSize()) + " byte record");
+        }
+        return scan(out, k, records, threads, [scoreOffset](const RecordView& record) {
+            return record.template field<ScoreType>(scoreOffset);
+        });
+    }
+
+    // score is computed by a scoring function on the record view
+    template <typename OutputIterator>
+    static size_t compute(OutputIterator out, size_t k, const Records& records, RecordScoringFunction scorer, size_t threads = 0) {
+        return scan(out, k, records, threads, scorer);
+    }
+
+private:
+    template <typename OutputIterator, typename Scorer>
+    static size_t scan(OutputIterator out, size_t k, const Records& records, size_t threads, const Scorer& scorer) {
+        auto indexScorer = [&records, &scorer](const size_t& index) { return scorer(records.record(index)); };
+        const size_t count = records.count();
+        if (threads == 0) {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        threads = std::max<size_t>(1, std::min(threads, count / kMinRecordsPerThread));
+
+        std::vector<Selector> selectors(threads, Selector(k, indexScorer));
+        auto scanChunk = [&](size_t chunk) {
+            size_t begin = count * chunk / threads;
+            size_t end = count * (chunk + 1) / threads;
+            Selector& selector = selectors[chunk];
+            for (size_t index = begin; index < end; ++index) {
+                selector.offerScored(index, scorer(records.record(index)));
+            }
+        };
+        if (threads == 1) {
+            scanChunk(0);
+        } else {
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (size_t chunk = 0; chunk < threads; ++chunk) {
+                workers.emplace_back(scanChunk, chunk);
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            for (size_t chunk = 1; chunk < threads; ++chunk) {
+                selectors[0].merge(selectors[chunk]);
+            }
+        }
+        return selectors[0].results(out, true, false);
+    }
+};
+
+template <typename ScoreType>
+using TopRecords = SelectRecords<ScoreType, std::greater<ScoreType>>;
+
+template <typename ScoreType>
+using BottomRecords = SelectRecords<ScoreType, std::less<ScoreType>>;
+
+}
@@ -0,0 +1,449 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : NN-Descent - approximate k-NN graph construction, searchable as an ANN index
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      k::NnDescentOptions options;            // iterations, sampleRate, delta, threads
+ *      k::NnDescent index(base.data(), count, dim, 20, k::Metric::L2, options);     // K = 20 neighbours per row
+ *      index.build();
+ *
+ *      auto graph = index.graph();             // graph[i] : the (approximate) 20 nearest other rows of row i
+ *      index.updates();                        // list changes per iteration (convergence)
+ *
+ *      std::vector<k::NnDescent::Neighbor> neighbors;          // (row, squared distance or similarity)
+ *      index.search(std::back_inserter(neighbors), query, 10);
+ *
+ *  Every row keeps its K nearest rows found so far in a bounded list : a max-heap on distance (the K-th best on
+ *  top, as in k::Bottom) that also rejects rows it already holds, each entry flagged new until it has been joined.
+ *  The lists start out random. Each iteration then joins, for every row, a sample of its new neighbours with each
+ *  other and with its old ones (reverse neighbours included) - a neighbour of a neighbour is likely a neighbour -
+ *  offering each computed distance to both rows' lists. Rows are split over threads; a striped lock guards each
+ *  list. The build stops after options.iterations or once an iteration changes fewer than delta * count * K list
+ *  entries; updates() keeps the change count of every iteration.
+ *
+ *  search() is a best-first beam search over the graph (forward and reverse edges, at most 2 * K per row) with the
+ *  beam in a bounded k::Select as in k::Hnsw. A k-NN graph of clustered data splits into one component per cluster,
+ *  so every search is seeded with kEntryPoints fixed random rows rather than a single entry point. A filter that
+ *  allows at most ef * 2 * K rows is searched with an exact scan of the allowed rows instead : the beam would
+ *  rarely fill through so few rows, and the walk would visit most of the graph.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include "select_k/select_k_filter.h"
+#include "select_k/select_k_kmeans.h"
+#include "select_k/select_k_vector.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <vector>
+namespace k {
+
+struct NnDescentOptions {
+    size_t iterations = 12;         // at most
+    float sampleRate = 0.5f;        // rho : new (and old) neighbours joined per row and iteration, as a fraction of K
+    float delta = 0.001f;           // stop once an iteration changes fewer than delta * count * K list entries
+    size_t efSearch = 64;           // default beam width of search() (raised to K if smaller)
+    size_t threads = 0;             // 0 = one per core
+    uint64_t seed = 42;
+};
+
+class NnDescent {
+public:
+    // (row index, score) - squared distance for Metric::L2, similarity otherwise (as k::Nearest)
+    using Neighbor = std::pair<size_t, float>;
+    // search beam, by distance (similarities are negated)
+    using Beam = Select<uint32_t, float, std::less<float>>;
+
+    static constexpr size_t kLockStripes = 4096;
+    // random rows scored first by every search (the graph of clustered data need not be connected)
+    static constexpr size_t kEntryPoints = 256;
+
+    // an empty graph over the count rows of data (not copied - must outlive the index), K neighbours per row
+    NnDescent(const float* data, size_t count, size_t dim, size_t k, Metric metric = Metric::L2, NnDescentOptions options = {})
+        : data_(data), count_(count), dim_(dim), k_(std::min(k, count > 0 ? count - 1 : 0)), metric_(metric),
+          options_(options), locks_(kLockStripes) {
+        if (metric_ == Metric::Cosine) {
+            normalized_.assign(data_, data_ + count_ * dim_);
+            simd::normalize(normalized_.data(), count_, dim_);
+            data_ = normalized_.data();
+        }
+    }
+
+    NnDescent(const NnDescent&) = delete;
+    NnDescent& operator=(const NnDescent&) = delete;
+
+    size_t count() const { return count_; }
+    size_t dim() const { return dim_; }
+    size_t k() const { return k_; }
+    Metric metric() const { return metric_; }
+    // list entries changed by each iteration
+    const std::vector<size_t>& updates() const { return updates_; }
+
+    void build() {
+        updates_.clear();
+        lists_.assign(count_ * k_, Entry{});
+        sizes_.assign(count_, 0);
+        if (k_ == 0) {
+            link();
+            return;
+        }
+        const size_t threads = KMeans::threadCount(options_.threads, count_);
+        // random initial lists
+        KMeans::forEachChunk(count_, threads, [this](size_t chunk, size_t begin, size_t end) {
+            std::mt19937_64 random(options_.seed + chunk);
+            for (size_t v = begin; v < end; ++v) {
+                while (sizes_[v] < k_) {
+                    const uint32_t u = static_cast<uint32_t>(random() % count_);
+                    if (u != v) {
+                        offer(static_cast<uint32_t>(v), u, distance(v, u));
+                    }
+                }
+            }
+        });
+
+        const size_t samples = std::max<size_t>(1, static_cast<size_t>(options_.sampleRate * float(k_)));
+        std::vector<std::vector<uint32_t>> olds(count_), news(count_);
+        for (size_t iteration = 0; iteration < options_.iterations; ++iteration) {
+            // each row's old neighbours and a sample of its new ones (which become old)
+            KMeans::forEachChunk(count_, threads, [&](size_t chunk, size_t begin, size_t end) {
+                std::mt19937_64 random(options_.seed + (iteration + 1) * threads + chunk);
+                std::vector<size_t> fresh;
+                for (size_t v = begin; v < end; ++v) {
+                    Entry* list = lists_.data() + v * k_;
+                    olds[v].clear();
+                    news[v].clear();
+                    fresh.clear();
+                    for (size_t i = 0; i < sizes_[v]; ++i) {
+                        if (list[i].fresh) {
+                            fresh.push_back(i);
+                        } else {
+                            olds[v].push_back(list[i].id);
+                        }
+                    }
+                    std::shuffle(fresh.begin(), fresh.end(), random);
+                    fresh.resize(std::min(fresh.size(), samples));
+                    for (size_t i : fresh) {
+                        news[v].push_back(list[i].id);
+                        list[i].fresh = false;
+                    }
+                }
+            });
+            addReverse(olds, news, samples, iteration);
+
+            // local join : new x new and new x old pairs of every row's neighbourhood
+            std::atomic<size_t> changed(0);
+            KMeans::forEachChunk(count_, threads, [&](size_t, size_t begin, size_t end) {
+                size_t local = 0;
+                for (size_t v = begin; v < end; ++v) {
+                    const std::vector<uint32_t>& fresh = news[v];
+                    for (size_t i = 0; i < fresh.size(); ++i) {
+                        for (size_t j = i + 1; j < fresh.size(); ++j) {
+                            local += join(fresh[i], fresh[j]);
+                        }
+                        for (uint32_t old : olds[v]) {
+                            local += join(fresh[i], old);
+                        }
+                    }
+                }
+                changed += local;
+            });
+            updates_.push_back(changed.load());
+            if (float(changed.load()) < options_.delta * float(count_) * float(k_)) { break; }
+        }
+        link();
+    }
+
+    // every row's K nearest other rows found, nearest first
+    std::vector<std::vector<Neighbor>> graph() const {
+        std::vector<std::vector<Neighbor>> graph(count_);
+        for (size_t v = 0; v < count_; ++v) {
+            const Entry* list = lists_.data() + v * k_;
+            for (size_t i = 0; i < sizes_[v]; ++i) {
+                graph[v].emplace_back(list[i].id, list[i].distance);
+            }
+            std::sort(graph[v].begin(), graph[v].end(), [](const Neighbor& a, const Neighbor& b) {
+                return a.second != b.second ? a.second < b.second : a.first < b.first;
+            });
+            if (metric_ != Metric::L2) {
+                for (auto& neighbor : graph[v]) {
+                    neighbor.second = -neighbor.second;
+                }
+            }
+        }
+        return graph;
+    }
+
+    /**
+     * the (approximate) K nearest rows to query among the rows filter allows, nearest first
+     * ef is the beam width (0 = options.efSearch), larger is slower and more accurate
+     * (a filter allowing at most ef * 2 * K rows is answered exactly by scanning them)
+     */
+    template <typename OutputIterator>
+    size_t search(OutputIterator out, const float* query, size_t k, size_t ef = 0, const Filter& filter = {}) const {
+        if (k == 0 || linkStart_.empty() || count_ == 0) { return 0; }
+        std::vector<float> prepared;
+        if (metric_ == Metric::Cosine) {
+            prepared.assign(query, query + dim_);
+            simd::normalize(prepared.data(), 1, dim_);
+            query = prepared.data();
+        }
+        ef = std::max({ef == 0 ? options_.efSearch : ef, k});
+        const bool scan = !filter.all() && filter.count(count_) <= ef * 2 * k_;
+        std::unique_ptr<Visited> visited = scan ? nullptr : acquireVisited();
+        Beam beam = scan ? scanAllowed(query, k, filter) : searchGraph(query, ef, *visited, filter);
+        if (visited) {
+            releaseVisited(std::move(visited));
+        }
+
+        std::vector<std::pair<uint32_t, float>> found;
+        beam.scoredResults(std::back_inserter(found), true);
+        const size_t n = std::min(k, found.size());
+        for (size_t i = 0; i < n; ++i) {
+            *out++ = Neighbor(found[i].first, metric_ == Metric::L2 ? found[i].second : -found[i].second);
+        }
+        return n;
+    }
+
+protected:
+    // a list entry : max-heap on distance, fresh until the row has been joined
+    struct Entry {
+        float distance = 0;
+        uint32_t id = 0;
+        bool fresh = false;
+
+        bool operator<(const Entry& other) const { return distance < other.distance; }
+    };
+
+    // per search visited marks : row i was reached in the current search if tags[i] == epoch
+    struct Visited {
+        std::vector<uint32_t> tags;
+        uint32_t epoch = 0;
+
+        void next() {
+            if (++epoch == 0) {
+                std::fill(tags.begin(), tags.end(), 0);
+                epoch = 1;
+            }
+        }
+    };
+
+    std::unique_ptr<Visited> acquireVisited() const {
+        {
+            std::lock_guard<std::mutex> guard(visitedMutex_);
+            if (!visitedPool_.empty()) {
+                std::unique_ptr<Visited> visited = std::move(visitedPool_.back());
+                visitedPool_.pop_back();
+                return visited;
+            }
+        }
+        auto visited = std::make_unique<Visited>();
+        visited->tags.assign(count_, 0);
+        return visited;
+    }
+
+    void releaseVisited(std::unique_ptr<Visited> visited) const {
+        std::lock_guard<std::mutex> guard(visitedMutex_);
+        visitedPool_.push_back(std::move(visited));
+    }
+
+    // distance (smaller is nearer) between rows / from a prepared query to a row
+    float distance(const float* query, size_t row) const {
+        return metric_ == Metric::L2 ? simd::squaredL2(query, data_ + row * dim_, dim_)
+                                     : -simd::dot(query, data_ + row * dim_, dim_);
+    }
+
+    float distance(size_t a, size_t b) const { return distance(data_ + a * dim_, b); }
+
+    /**
+     * offers u to row v's list : rejected if v already holds u, or if the list is full and u is not nearer than
+     * its K-th entry, otherwise u replaces the K-th entry. Returns whether the list changed.
+     */
+    bool offer(uint32_t v, uint32_t u, float d) {
+        std::lock_guard<std::mutex> guard(locks_[v % kLockStripes]);
+        Entry* list = lists_.data() + size_t(v) * k_;
+        uint32_t& size = sizes_[v];
+        if (size == k_ && !(d < list[0].distance)) { return false; }
+        for (uint32_t i = 0; i < size; ++i) {
+            if (list[i].id == u) { return false; }
+        }
+        if (size == k_) {
+            std::pop_heap(list, list + size);
+            --size;
+        }
+        list[size++] = Entry{ d, u, true };
+        std::push_heap(list, list + size);
+        return true;
+    }
+
+    // one distance, offered to both rows
+    size_t join(uint32_t a, uint32_t b) {
+        if (a == b) { return 0; }
+        const float d = distance(a, b);
+        return size_t(offer(a, b, d)) + size_t(offer(b, a, d));
+    }
+
+    // adds a sample of at most samples reverse neighbours (rows listing v) to olds[v] / news[v]
+    void addReverse(std::vector<std::vector<uint32_t>>& olds, std::vector<std::vector<uint32_t>>& news, size_t samples,
+                    size_t iteration) const {
+        std::vector<std::vector<uint32_t>> reverseOld(count_), reverseNew(count_);
+        std::vector<uint32_t> seenOld(count_, 0), seenNew(count_, 0);
+        std::mt19937_64 random(options_.seed ^ (iteration + 1));
+        // reservoir sampling keeps every reverse neighbour equally likely
+        auto add = [&random, samples](std::vector<uint32_t>& reservoir, uint32_t& seen, uint32_t row) {
+            ++seen;
+            if (reservoir.size() < samples) {
+                reservoir.push_back(row);
+            } else if (size_t slot = random() % seen; slot < samples) {
+                reservoir[slot] = row;
+            }
+        };
+        for (size_t v = 0; v < count_; ++v) {
+            for (uint32_t u : olds[v]) {
+                add(reverseOld[u], seenOld[u], static_cast<uint32_t>(v));
+            }
+            for (uint32_t u : news[v]) {
+                add(reverseNew[u], seenNew[u], static_cast<uint32_t>(v));
+            }
+        }
+        KMeans::forEachChunk(count_, KMeans::threadCount(options_.threads, count_), [&](size_t, size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v) {
+                merge(olds[v], reverseOld[v]);
+                merge(news[v], reverseNew[v]);
+            }
+        });
+    }
+
+    static void merge(std::vector<uint32_t>& rows, const std::vector<uint32_t>& more) {
+        rows.insert(rows.end(), more.begin(), more.end());
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    }
+
+    // search adjacency : each row's list, then rows listing it, at most 2 * K (CSR in linkStart_ / links_)
+    void link() {
+        std::vector<std::vector<uint32_t>> adjacency(count_);
+        for (size_t v = 0; v < count_; ++v) {
+            const Entry* list = lists_.data() + v * k_;
+            for (size_t i = 0; i < sizes_[v]; ++i) {
+                adjacency[v].push_back(list[i].id);
+            }
+        }
+        for (size_t v = 0; v < count_; ++v) {
+            const Entry* list = lists_.data() + v * k_;
+            for (size_t i = 0; i < sizes_[v]; ++i) {
+                std::vector<uint32_t>& reverse = adjacency[list[i].id];
+                if (reverse.size() < 2 * k_ && std::find(reverse.begin(), reverse.end(), v) == reverse.end()) {
+                    reverse.push_back(static_cast<uint32_t>(v));
+                }
+            }
+        }
+        linkStart_.assign(count_ + 1, 0);
+        for (size_t v = 0; v < count_; ++v) {
+            linkStart_[v + 1] = linkStart_[v] + adjacency[v].size();
+        }
+        links_.clear();
+        links_.reserve(linkStart_[count_]);
+        for (const auto& rows : adjacency) {
+            links_.insert(links_.end(), rows.begin(), rows.end());
+        }
+        entries_.clear();
+        std::mt19937_64 random(options_.seed);
+        for (size_t i = 0; i < std::min(kEntryPoints, count_); ++i) {
+            entries_.push_back(static_cast<uint32_t>(random() % count_));
+        }
+    }
+
+    // exact scan of the rows filter allows (for filters too selective for the graph walk)
+    Beam scanAllowed(const float* query, size_t k, const Filter& filter) const {
+        Beam beam(k, [this, query](const uint32_t& row) { return distance(query, row); });
+        filter.forEach(count_, [&](size_t row) {
+            const float d = distance(query, row);
+            if (!beam.full() || d < beam.threshold()) {
+                beam.offerScored(static_cast<uint32_t>(row), d);
+            }
+        });
+        return beam;
+    }
+
+    // best-first beam search from the entry rows : the ef nearest (allowed) rows reached
+    Beam searchGraph(const float* query, size_t ef, Visited& visited, const Filter& filter) const {
+        visited.next();
+        const uint32_t epoch = visited.epoch;
+        std::vector<uint32_t>& tags = visited.tags;
+        Beam beam(ef, [this, query](const uint32_t& row) { return distance(query, row); });
+        // rows still to expand, nearest on top
+        using Candidate = std::pair<float, uint32_t>;
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+        auto reach = [&](uint32_t row) {
+            if (tags[row] == epoch) { return; }
+            tags[row] = epoch;
+            const float d = distance(query, row);
+            if (!beam.full() || d < beam.threshold()) {
+                // disallowed rows are only walked through
+                if (filter.allows(row)) {
+                    beam.offerScored(row, d);
+                }
+                candidates.push({d, row});
+            }
+        };
+        for (uint32_t entry : entries_) {
+            reach(entry);
+        }
+        while (!candidates.empty()) {
+            auto [nearest, row] = candidates.top();
+            if (beam.full() && nearest > beam.threshold()) { break; }
+            candidates.pop();
+            for (size_t i = linkStart_[row]; i < linkStart_[row + 1]; ++i) {
+                reach(links_[i]);
+            }
+        }
+        return beam;
+    }
+
+    const float* data_;
+    size_t count_;
+    size_t dim_;
+    size_t k_;
+    Metric metric_;
+    NnDescentOptions options_;
+    std::vector<float> normalized_;
+
+    // row v's list : lists_[v * K, v * K + sizes_[v]), a max-heap on distance
+    std::vector<Entry> lists_;
+    std::vector<uint32_t> sizes_;
+    std::vector<size_t> updates_;
+
+    std::vector<size_t> linkStart_;
+    std::vector<uint32_t> links_;
+    std::vector<uint32_t> entries_;
+
+    std::vector<std::mutex> locks_;
+    mutable std::mutex visitedMutex_;
+    mutable std::vector<std::unique_ptr<Visited>> visitedPool_;
+};
+
+}
@@ -0,0 +1,277 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : product quantization - compressed vector codes, ADC lookup tables and exact re-rank
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      k::PqOptions options;                   // subspaces (bytes per row at 8 bits), bits = 8 or 4, rerank
+ *      k::Pq index(base.data(), count, dim, options);
+ *      index.build();                          // trains one codebook per subspace and encodes every row
+ *
+ *      std::vector<k::Pq::Neighbor> neighbors;                 // (row, exact squared distance), nearest first
+ *      index.search(std::back_inserter(neighbors), query, 10);
+ *      index.search(std::back_inserter(neighbors), query, 10, 0, k::Filter(allowed));   // allow-list (select_k_filter.h)
+ *
+ *  Each row is split into subspaces (M) slices; every slice is replaced by the index of its nearest centroid in
+ *  that subspace's codebook (k::KMeans, 256 or 16 centroids), so a row costs M bytes (8 bit) or M / 2 bytes (4 bit).
+ *  A query first builds its lookup tables (squared distance from each query slice to every centroid), after which
+ *  the approximate (ADC) distance of any row is M table lookups :
+ *
+ *      8 bit : codes are stored row by row, tables are float, each row sums M table entries
+ *      4 bit : codes are stored in blocks of 32 rows (nibbles interleaved for simd::lookupAdd4), tables are
+ *              quantized to uint8 per query, and each subspace of a block is a single pshufb on AVX2
+ *
+ *  The R (rerank, at least K) rows with the smallest approximate distance are kept in a bounded selector and then
+ *  re-ranked with exact distances against the original rows into the final K. Only the codes live in the index -
+ *  the rows are read back for re-ranking only, so they can stay in a memory mapped file.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include "select_k/select_k_filter.h"
+#include "select_k/select_k_kmeans.h"
+#include "select_k/select_k_simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+namespace k {
+
+struct PqOptions {
+    size_t subspaces = 8;               // M, slices per row (need not divide dim)
+    size_t bits = 8;                    // 8 (256 centroids per subspace) or 4 (16 centroids, fast scan)
+    size_t rerank = 0;                  // R, approximate candidates re-ranked exactly, 0 = 8 * K
+    size_t threads = 0;                 // training and encoding threads, 0 = one per core
+    KMeansOptions kmeans;               // (kmeans.threads is taken from threads)
+};
+
+class Pq {
+public:
+    // (row index, exact squared L2 distance)
+    using Neighbor = std::pair<size_t, float>;
+    using Selector = Select<size_t, float, std::less<float>>;
+
+    // rows per 4 bit code block
+    static constexpr size_t kBlock = 32;
+
+    // an empty index over the count rows of data (only read again to re-rank; must outlive the index)
+    Pq(const float* data, size_t count, size_t dim, PqOptions options = {})
+        : data_(data), count_(count), dim_(dim), options_(options) {
+        options_.subspaces = std::max<size_t>(1, std::min(options_.subspaces, dim_));
+        options_.bits = options_.bits == 4 ? 4 : 8;
+        options_.kmeans.threads = options_.threads;
+        subspaces_ = options_.subspaces;
+        centroids_ = size_t(1) << options_.bits;
+        for (size_t s = 0; s <= subspaces_; ++s) {
+            offsets_.push_back(s * dim_ / subspaces_);
+        }
+    }
+
+    size_t count() const { return count_; }
+    size_t dim() const { return dim_; }
+    size_t subspaces() const { return subspaces_; }
+    size_t bits() const { return options_.bits; }
+    // code bytes held by the index
+    size_t codeBytes() const { return codes_.size(); }
+
+    void build() {
+        codebooks_.assign(centroids_ * dim_, 0.0f);
+        if (count_ == 0) { return; }
+        for (size_t s = 0; s < subspaces_; ++s) {
+            const size_t width = offsets_[s + 1] - offsets_[s];
+            // the subspace's slices (of at most centroids * maxSamplesPerCentroid rows, spread over the data)
+            const size_t samples = std::min(count_, centroids_ * options_.kmeans.maxSamplesPerCentroid);
+            std::vector<float> slices(samples * width);
+            for (size_t i = 0; i < samples; ++i) {
+                const float* row = data_ + (i * count_ / samples) * dim_ + offsets_[s];
+                std::copy(row, row + width, slices.begin() + i * width);
+            }
+            std::vector<float> codebook = KMeans::train(slices.data(), samples, width, centroids_, options_.kmeans);
+            std::copy(codebook.begin(), codebook.end(), codebooks_.begin() + centroids_ * offsets_[s]);
+        }
+        encode();
+    }
+
+    /**
+     * the K nearest rows to query among the rows filter allows : R candidates by approximate distance, re-ranked
+     * exactly, nearest first
+     */
+    template <typename OutputIterator>
+    size_t search(OutputIterator out, const float* query, size_t k, size_t rerank = 0, const Filter& filter = {}) const {
+        if (k == 0 || codes_.empty()) { return 0; }
+        rerank = std::max(k, rerank != 0 ? rerank : (options_.rerank != 0 ? options_.rerank : 8 * k));
+        std::vector<float> tables = lookupTables(query);
+        Selector candidates = options_.bits == 8 ? scan8(tables, rerank, filter) : scan4(tables, rerank, filter);
+
+        std::vector<size_t> rows;
+        rows.reserve(candidates.size());
+        candidates.results(std::back_inserter(rows), false, false);
+        Selector exact(k, [this, query](const size_t& row) { return simd::squaredL2(query, data_ + row * dim_, dim_); });
+        for (size_t row : rows) {
+            exact.offer(row);
+        }
+        return exact.scoredResults(out, true);
+    }
+
+    // approximate (ADC) squared distance from query to row
+    float approximateDistance(const float* query, size_t row) const {
+        std::vector<float> tables = lookupTables(query);
+        float sum = 0;
+        for (size_t s = 0; s < subspaces_; ++s) {
+            sum += tables[s * centroids_ + code(row, s)];
+        }
+        return sum;
+    }
+
+    // centroid index of row in subspace s
+    size_t code(size_t row, size_t s) const {
+        if (options_.bits == 8) {
+            return codes_[row * subspaces_ + s];
+        }
+        const uint8_t packed = codes_[((row / kBlock) * subspaces_ + s) * 16 + row % 16];
+        return row % kBlock < 16 ? (packed & 0x0f) : (packed >> 4);
+    }
+
+protected:
+    const float* codebook(size_t s) const { return codebooks_.data() + centroids_ * offsets_[s]; }
+
+    // tables[s * centroids + c] = squared distance from the query's slice s to centroid c of subspace s
+    std::vector<float> lookupTables(const float* query) const {
+        std::vector<float> tables(subspaces_ * centroids_);
+        for (size_t s = 0; s < subspaces_; ++s) {
+            simd::squaredL2Block(query + offsets_[s], codebook(s), centroids_, offsets_[s + 1] - offsets_[s],
+                                 tables.data() + s * centroids_);
+        }
+        return tables;
+    }
+
+    void encode() {
+        const size_t blocks = (count_ + kBlock - 1) / kBlock;
+        codes_.assign(options_.bits == 8 ? count_ * subspaces_ : blocks * subspaces_ * 16, 0);
+        // 4 bit rows of one block share bytes, so threads take whole blocks
+        KMeans::forEachChunk(blocks, KMeans::threadCount(options_.threads, count_), [this](size_t, size_t begin, size_t end) {
+            std::vector<float> distances(centroids_);
+            for (size_t row = begin * kBlock; row < std::min(count_, end * kBlock); ++row) {
+                for (size_t s = 0; s < subspaces_; ++s) {
+                    simd::squaredL2Block(data_ + row * dim_ + offsets_[s], codebook(s), centroids_,
+                                         offsets_[s + 1] - offsets_[s], distances.data());
+                    const uint8_t c = static_cast<uint8_t>(std::min_element(distances.begin(), distances.end()) - distances.begin());
+                    if (options_.bits == 8) {
+                        codes_[row * subspaces_ + s] = c;
+                    } else {
+                        uint8_t& packed = codes_[((row / kBlock) * subspaces_ + s) * 16 + row % 16];
+                        packed = static_cast<uint8_t>(row % kBlock < 16 ? (packed | c) : (packed | (c << 4)));
+                    }
+                }
+            }
+        });
+    }
+
+    Selector scan8(const std::vector<float>& tables, size_t rerank, const Filter& filter) const {
+        Selector selector(rerank, [this, &tables](const size_t& row) {
+            float sum = 0;
+            for (size_t s = 0; s < subspaces_; ++s) {
+                sum += tables[s * centroids_ + codes_[row * subspaces_ + s]];
+            }
+            return sum;
+        });
+        auto offer = [&](size_t row) {
+            const uint8_t* code = codes_.data() + row * subspaces_;
+            float sum = 0;
+            for (size_t s = 0; s < subspaces_; ++s) {
+                sum += tables[s * centroids_ + code[s]];
+            }
+            if (!selector.full() || sum < selector.threshold()) {
+                selector.offerScored(row, sum);
+            }
+        };
+        if (!filter.all()) {
+            filter.forEach(count_, offer);
+            return selector;
+        }
+        for (size_t row = 0; row < count_; ++row) {
+            offer(row);
+        }
+        return selector;
+    }
+
+    /**
+     * Tables are quantized per query to uint8 : subspace s maps [min_s, max_s] onto 0 .. 255 * range_s / range with
+     * its own offset min_s, where range is the widest subspace's range - so the widest table uses all 256 levels
+     * whatever M is, and every table shares the one scale that lets the integer sum rank rows like the float sum (up
+     * to the rounding, which the exact re-rank absorbs). The 16 bit sums saturate (M > 257 only).
+     */
+    Selector scan4(const std::vector<float>& tables, size_t rerank, const Filter& filter) const {
+        std::vector<float> minimum(subspaces_);
+        float range = 0;
+        for (size_t s = 0; s < subspaces_; ++s) {
+            const float* table = tables.data() + s * centroids_;
+            minimum[s] = *std::min_element(table, table + centroids_);
+            range = std::max(range, *std::max_element(table, table + centroids_) - minimum[s]);
+        }
+        const float scale = range > 0 ? 255.0f / range : 0.0f;
+        std::vector<uint8_t> quantized(subspaces_ * 16);
+        for (size_t s = 0; s < subspaces_; ++s) {
+            for (size_t c = 0; c < 16; ++c) {
+                const long level = std::lround((tables[s * 16 + c] - minimum[s]) * scale);
+                quantized[s * 16 + c] = static_cast<uint8_t>(std::clamp(level, 0L, 255L));
+            }
+        }
+
+        Selector selector(rerank, [this, &quantized](const size_t& row) {
+            float sum = 0;
+            for (size_t s = 0; s < subspaces_; ++s) {
+                sum += quantized[s * 16 + code(row, s)];
+            }
+            return sum;
+        });
+        uint16_t sums[kBlock];
+        for (size_t first = 0; first < count_; first += kBlock) {
+            // the block's 32 bits of the filter : blocks with no allowed row are not scanned
+            const uint64_t allowed = (filter.word(first / 64) & Filter::mask(first / 64, count_)) >> (first % 64);
+            if ((allowed & 0xffffffffu) == 0) { continue; }
+            simd::lookupAdd4(codes_.data() + (first / kBlock) * subspaces_ * 16, quantized.data(), subspaces_, sums);
+            const size_t rows = std::min(kBlock, count_ - first);
+            for (size_t i = 0; i < rows; ++i) {
+                if (((allowed >> i) & 1) == 0) { continue; }
+                const float sum = sums[i];
+                if (!selector.full() || sum < selector.threshold()) {
+                    selector.offerScored(first + i, sum);
+                }
+            }
+        }
+        return selector;
+    }
+
+    const float* data_;
+    size_t count_;
+    size_t dim_;
+    PqOptions options_;
+    size_t subspaces_;
+    size_t centroids_;
+    // slice s of a row is [offsets_[s], offsets_[s + 1])
+    std::vector<size_t> offsets_;
+    // subspace s codebook : centroids x slice width floats, starting at centroids * offsets_[s]
+    std::vector<float> codebooks_;
+    std::vector<uint8_t> codes_;
+};
+
+}
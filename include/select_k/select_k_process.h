@@ -0,0 +1,117 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : local multi-process map-reduce over serialized partial selectors (POSIX)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      k::Top<Row, double> selector(k, scoringFunction);
+ *      bool ok = k::forkMerge(selector, 8, [&](size_t shard, k::Top<Row, double>& partial) {
+ *          // runs in a forked worker process : offer this shard's candidates to partial
+ *      });
+ *      // selector now holds the best K over all shards (merged with whatever it held before)
+ *
+ *  Every worker streams its selection back to the parent over a pipe (Select::serialize()) and the parent
+ *  merges the partial selections as they are read (Select::deserialize() + merge()). Candidate and score types
+ *  must be trivially copyable, or a codec with encode() / decode() overloads must be given as Codec.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include "select_k/select_k_codec.h"
+#include <vector>
+#include <cstdio>
+#include <cerrno>
+#include <system_error>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+namespace k {
+
+/**
+ * Forks workers processes, worker i runs map(i, partial) on an empty selector with the same k and scoring function
+ * and sends the partial selection back over a pipe. The parent merges all partial selections into selector.
+ * Returns false if a worker could not be started, failed, or sent back a truncated selection.
+ */
+template <typename Codec = FdCodec, typename Selector, typename MapFunction>
+bool forkMerge(Selector& selector, size_t workers, MapFunction map) {
+    struct Worker {
+        pid_t pid;
+        int fd;
+    };
+    std::vector<Worker> started;
+    bool ok = true;
+    // unflushed stdio buffers would otherwise be written once per process
+    std::fflush(nullptr);
+    for (size_t shard = 0; shard < workers; ++shard) {
+        int fds[2];
+        if (::pipe(fds) != 0) {
+            ok = false;
+            break;
+        }
+        pid_t pid = ::fork();
+        if (pid < 0) {
+            ::close(fds[0]);
+            ::close(fds[1]);
+            ok = false;
+            break;
+        }
+        if (pid == 0) {
+            // worker : the forked copy of selector is reused as the partial selector
+            ::close(fds[0]);
+            for (const auto& worker : started) {
+                ::close(worker.fd);
+            }
+            int status = 0;
+            try {
+                selector.clear();
+                map(shard, selector);
+                Codec codec(fds[1]);
+                selector.serialize(codec);
+            } catch (...) {
+                status = 1;
+            }
+            ::close(fds[1]);
+            ::_exit(status);
+        }
+        ::close(fds[1]);
+        started.push_back({ pid, fds[0] });
+    }
+
+    Selector partial(selector.k(), selector.scorer());
+    for (const auto& worker : started) {
+        Codec codec(worker.fd);
+        partial.clear();
+        if (partial.deserialize(codec)) {
+            selector.merge(partial);
+        } else {
+            ok = false;
+        }
+        ::close(worker.fd);
+        int status = 0;
+        while (::waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {}
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+}
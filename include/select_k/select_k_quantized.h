@@ -0,0 +1,187 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : k-nearest neighbours over int8 / fp16 compressed rows with full precision re-ranking
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      k::QuantizedNearest index(base.data(), count, dim, k::Storage::Int8);   // or k::Storage::Half
+ *
+ *      std::vector<k::QuantizedNearest::Neighbor> neighbors;   // (row, exact squared distance), nearest first
+ *      index.search(std::back_inserter(neighbors), query, 10);
+ *      index.search(std::back_inserter(neighbors), query, 10, 0, k::Filter(allowed));   // allow-list (select_k_filter.h)
+ *
+ *  A lighter alternative to k::Pq (select_k_pq.h) : rows are scanned in a compressed copy and the R (rerank, at
+ *  least K) best approximate candidates are re-scored against the float rows.
+ *
+ *      Int8 : 1 byte per value, symmetric per-dimension scales s[d] = max |x[d]| / 127. The query is folded
+ *             into the scales (w[d] = y[d] * s[d]) and quantized to int8 itself, so the scan is an exact integer
+ *             dot product (AVX-512 VNNI vpdpwssd, or AVX2 madd) : ||y - x||^2 ~ ||y||^2 + ||x'||^2 - 2 t (p . q)
+ *             with ||x'||^2 the norm of the dequantized row, precomputed.
+ *      Half : IEEE fp16, 2 bytes per value, converted on the fly by F16C inside the L2 kernel.
+ *
+ *  The float rows are only read for re-ranking, so they may live in a memory mapped file.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include "select_k/select_k_filter.h"
+#include "select_k/select_k_simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+namespace k {
+
+enum class Storage {
+    Int8,       // int8 codes, per-dimension scales (4x smaller than float)
+    Half,       // IEEE fp16 (2x smaller than float)
+};
+
+class QuantizedNearest {
+public:
+    // (row index, exact squared L2 distance)
+    using Neighbor = std::pair<size_t, float>;
+    using Selector = Select<size_t, float, std::less<float>>;
+
+    /**
+     * compresses the count rows of data (kept by reference for re-ranking, must outlive the index)
+     * rerank = 0 over-fetches 4 * K candidates
+     */
+    QuantizedNearest(const float* data, size_t count, size_t dim, Storage storage = Storage::Int8, size_t rerank = 0)
+        : data_(data), count_(count), dim_(dim), storage_(storage), rerank_(rerank) {
+        if (storage_ == Storage::Half) {
+            halves_.resize(count_ * dim_);
+            simd::toHalf(data_, halves_.data(), count_ * dim_);
+            return;
+        }
+        scales_.assign(dim_, 0.0f);
+        for (size_t i = 0; i < count_; ++i) {
+            for (size_t d = 0; d < dim_; ++d) {
+                scales_[d] = std::max(scales_[d], std::abs(data_[i * dim_ + d]));
+            }
+        }
+        for (float& scale : scales_) {
+            scale = scale > 0 ? scale / 127.0f : 1.0f;
+        }
+        codes_.resize(count_ * dim_);
+        norms_.resize(count_);
+        for (size_t i = 0; i < count_; ++i) {
+            float norm = 0;
+            for (size_t d = 0; d < dim_; ++d) {
+                float code = std::clamp(std::round(data_[i * dim_ + d] / scales_[d]), -127.0f, 127.0f);
+                codes_[i * dim_ + d] = static_cast<int8_t>(code);
+                norm += (code * scales_[d]) * (code * scales_[d]);
+            }
+            norms_[i] = norm;
+        }
+    }
+
+    size_t count() const { return count_; }
+    size_t dim() const { return dim_; }
+    Storage storage() const { return storage_; }
+    // bytes of compressed rows held by the index
+    size_t codeBytes() const { return storage_ == Storage::Half ? halves_.size() * sizeof(uint16_t) : codes_.size(); }
+
+    /**
+     * the K nearest rows to query among the rows filter allows : R candidates by approximate distance, re-scored in
+     * float, nearest first
+     */
+    template <typename OutputIterator>
+    size_t search(OutputIterator out, const float* query, size_t k, size_t rerank = 0, const Filter& filter = {}) const {
+        if (k == 0) { return 0; }
+        rerank = std::max(k, rerank != 0 ? rerank : (rerank_ != 0 ? rerank_ : 4 * k));
+        Selector candidates = storage_ == Storage::Half ? scanHalf(query, rerank, filter) : scanInt8(query, rerank, filter);
+
+        std::vector<size_t> rows;
+        rows.reserve(candidates.size());
+        candidates.results(std::back_inserter(rows), false, false);
+        Selector exact(k, [this, query](const size_t& row) { return simd::squaredL2(query, data_ + row * dim_, dim_); });
+        for (size_t row : rows) {
+            exact.offer(row);
+        }
+        return exact.scoredResults(out, true);
+    }
+
+protected:
+    // calls fn(row) for every row filter allows
+    template <typename RowFunction>
+    void forEachRow(const Filter& filter, RowFunction fn) const {
+        if (!filter.all()) {
+            filter.forEach(count_, fn);
+            return;
+        }
+        for (size_t row = 0; row < count_; ++row) {
+            fn(row);
+        }
+    }
+
+    Selector scanHalf(const float* query, size_t rerank, const Filter& filter) const {
+        Selector selector(rerank, [this, query](const size_t& row) {
+            return simd::squaredL2Half(query, halves_.data() + row * dim_, dim_);
+        });
+        forEachRow(filter, [&](size_t row) {
+            const float d = simd::squaredL2Half(query, halves_.data() + row * dim_, dim_);
+            if (!selector.full() || d < selector.threshold()) {
+                selector.offerScored(row, d);
+            }
+        });
+        return selector;
+    }
+
+    Selector scanInt8(const float* query, size_t rerank, const Filter& filter) const {
+        // w = query folded into the scales, quantized to p = round(w / t)
+        std::vector<int8_t> folded(dim_);
+        float largest = 0;
+        for (size_t d = 0; d < dim_; ++d) {
+            largest = std::max(largest, std::abs(query[d] * scales_[d]));
+        }
+        const float t = largest > 0 ? largest / 127.0f : 1.0f;
+        for (size_t d = 0; d < dim_; ++d) {
+            folded[d] = static_cast<int8_t>(std::clamp(std::round(query[d] * scales_[d] / t), -127.0f, 127.0f));
+        }
+        const float queryNorm = simd::dot(query, query, dim_);
+        auto approximate = [this, &folded, queryNorm, t](size_t row) {
+            return queryNorm + norms_[row] - 2 * t * float(simd::dotInt8(folded.data(), codes_.data() + row * dim_, dim_));
+        };
+
+        Selector selector(rerank, [&approximate](const size_t& row) { return approximate(row); });
+        forEachRow(filter, [&](size_t row) {
+            const float d = approximate(row);
+            if (!selector.full() || d < selector.threshold()) {
+                selector.offerScored(row, d);
+            }
+        });
+        return selector;
+    }
+
+    const float* data_;
+    size_t count_;
+    size_t dim_;
+    Storage storage_;
+    size_t rerank_;
+
+    std::vector<uint16_t> halves_;
+    std::vector<float> scales_;
+    std::vector<int8_t> codes_;
+    std::vector<float> norms_;
+};
+
+}
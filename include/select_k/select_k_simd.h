@@ -0,0 +1,773 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : float vector distance kernels (AVX-512 / AVX2+FMA / scalar, picked at runtime)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ *  k::simd::squaredL2(a, b, dim)                           - ||a - b||^2
+ *  k::simd::squaredL2Block(query, base, count, dim, out)   - out[i] = ||query - base[i]||^2 for count rows of base
+ *  k::simd::dot(a, b, dim)                                 - a . b
+ *  k::simd::dotBlock(query, base, count, dim, out)         - out[i] = query . base[i]
+ *  k::simd::dotTile(queries, queryCount, base, count, dim, out) - out[q * count + i] = queries[q] . base[i]
+ *  k::simd::normalize(data, count, dim)                    - scales count rows to unit L2 norm (in place)
+ *  k::simd::lookupAdd4(codes, tables, subspaces, out)      - 4 bit PQ fast scan of 32 codes (see below)
+ *  k::simd::dotInt8(a, b, dim)                             - int8 a . int8 b, exact int32 (AVX-512 VNNI / AVX2)
+ *  k::simd::squaredL2Half(query, row, dim)                 - ||query - row||^2 for an fp16 row (F16C)
+ *  k::simd::toHalf(in, out, count) / toFloat(in, out, count) - fp32 <-> fp16 (IEEE binary16, round to nearest even)
+ *  k::simd::hammingBlock(query, codes, count, words, out)  - out[i] = popcount(query ^ codes[i]) over words uint64s
+ *
+ *  The instruction set is detected once (GCC / Clang on x86-64, __builtin_cpu_supports) and every kernel is
+ *  compiled for each level with target attributes, so the library needs no -mavx2 / -mavx512f build flags.
+ *  Other compilers / architectures get the scalar kernels. SELECT_K_SIMD=scalar|avx2 caps the level used.
+ *
+ *  dotTile is the GEMM style kernel behind batch k-NN : a register tile of queries x rows (4 x 3 on AVX2, 4 x 4 on
+ *  AVX-512) is accumulated in parallel so every load of a query or base vector feeds 3 or 4 FMAs instead of one.
+ *
+ *  lookupAdd4 sums uint8 lookup tables over 4 bit codes for a block of 32 codes at once : codes holds 16 bytes per
+ *  subspace (low nibble = code of entry i, high nibble = code of entry i + 16), tables 16 bytes per subspace, and
+ *  out[i] = sum over subspaces s of tables[s * 16 + code(i, s)], saturating at 65535 (exact up to 257 subspaces).
+ *  On AVX2 each subspace is one pshufb lookup.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <immintrin.h>
+#define SELECT_K_X86_DISPATCH 1
+#endif
+namespace k {
+namespace simd {
+
+enum class Level {
+    Scalar,
+    Avx2,       // AVX2 + FMA
+    Avx512,     // AVX-512 F
+};
+
+// best level supported by the CPU, SELECT_K_SIMD=scalar|avx2|avx512 in the environment caps it (e.g. for testing)
+inline Level detectLevel() {
+    Level supported = Level::Scalar;
+#ifdef SELECT_K_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        supported = Level::Avx512;
+    } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        supported = Level::Avx2;
+    }
+#endif
+    const char* requested = std::getenv("SELECT_K_SIMD");
+    if (requested != nullptr) {
+        std::string_view name(requested);
+        Level cap = name == "scalar" ? Level::Scalar : name == "avx2" ? Level::Avx2 : Level::Avx512;
+        if (cap < supported) { supported = cap; }
+    }
+    return supported;
+}
+
+inline Level level() {
+    static const Level detected = detectLevel();
+    return detected;
+}
+
+// AVX-512 VNNI (with BW / VL) for the int8 kernels, only used at Level::Avx512
+inline bool hasVnni() {
+#ifdef SELECT_K_X86_DISPATCH
+    static const bool supported = level() == Level::Avx512 && __builtin_cpu_supports("avx512bw") &&
+                                  __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512vnni");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// AVX-512 VPOPCNTDQ for the hamming kernel, only used at Level::Avx512
+inline bool hasVpopcntdq() {
+#ifdef SELECT_K_X86_DISPATCH
+    static const bool supported = level() == Level::Avx512 && __builtin_cpu_supports("avx512vpopcntdq");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// F16C conversions for the fp16 kernels, only used from Level::Avx2 up
+inline bool hasF16c() {
+#ifdef SELECT_K_X86_DISPATCH
+    static const bool supported = level() != Level::Scalar && __builtin_cpu_supports("f16c");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+namespace scalar {
+
+inline float squaredL2(const float* a, const float* b, size_t dim) {
+    float sum = 0;
+    for (size_t i = 0; i < dim; ++i) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+inline float dot(const float* a, const float* b, size_t dim) {
+    float sum = 0;
+    for (size_t i = 0; i < dim; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+inline int32_t dotInt8(const int8_t* a, const int8_t* b, size_t dim) {
+    int32_t sum = 0;
+    for (size_t i = 0; i < dim; ++i) {
+        sum += int32_t(a[i]) * int32_t(b[i]);
+    }
+    return sum;
+}
+
+inline float halfToFloat(uint16_t half) {
+    const uint32_t sign = uint32_t(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);            // inf / nan
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;                                            // +-0
+    } else {
+        // subnormal : normalize the mantissa
+        exponent = 113;
+        while ((mantissa & 0x400) == 0) {
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const uint32_t exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (exponent == 0xff) {
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+    }
+    int32_t halfExponent = int32_t(exponent) - 112;
+    if (halfExponent >= 0x1f) {
+        return static_cast<uint16_t>(sign | 0x7c00);            // overflow to inf
+    }
+    if (halfExponent <= 0) {
+        // subnormal (or zero) half : shift the implicit bit in, then round to nearest even
+        if (halfExponent < -10) { return sign; }
+        mantissa |= 0x800000;
+        const uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t middle = 1u << (shift - 1);
+        if (rest > middle || (rest == middle && (half & 1))) { ++half; }
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = (uint32_t(halfExponent) << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1fff;
+    // a carry out of the mantissa correctly bumps the exponent (up to inf)
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) { ++half; }
+    return static_cast<uint16_t>(sign | half);
+}
+
+inline float squaredL2Half(const float* query, const uint16_t* row, size_t dim) {
+    float sum = 0;
+    for (size_t i = 0; i < dim; ++i) {
+        float d = query[i] - halfToFloat(row[i]);
+        sum += d * d;
+    }
+    return sum;
+}
+
+inline uint32_t hamming(const uint64_t* a, const uint64_t* b, size_t words) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < words; ++i) {
+        sum += static_cast<uint32_t>(__builtin_popcountll(a[i] ^ b[i]));
+    }
+    return sum;
+}
+
+inline void lookupAdd4(const uint8_t* codes, const uint8_t* tables, size_t subspaces, uint16_t* out) {
+    for (size_t i = 0; i < 32; ++i) {
+        out[i] = 0;
+    }
+    for (size_t s = 0; s < subspaces; ++s) {
+        const uint8_t* block = codes + s * 16;
+        const uint8_t* table = tables + s * 16;
+        for (size_t i = 0; i < 16; ++i) {
+            out[i] = static_cast<uint16_t>(std::min(0xffff, out[i] + table[block[i] & 0x0f]));
+            out[i + 16] = static_cast<uint16_t>(std::min(0xffff, out[i + 16] + table[block[i] >> 4]));
+        }
+    }
+}
+
+}
+
+#ifdef SELECT_K_X86_DISPATCH
+namespace avx2 {
+
+__attribute__((target("avx2,fma"))) inline float horizontalSum(__m256 v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma"))) inline float squaredL2(const float* a, const float* b, size_t dim) {
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        sum0 = _mm256_fmadd_ps(d0, d0, sum0);
+        sum1 = _mm256_fmadd_ps(d1, d1, sum1);
+    }
+    for (; i + 8 <= dim; i += 8) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        sum0 = _mm256_fmadd_ps(d0, d0, sum0);
+    }
+    float sum = horizontalSum(_mm256_add_ps(sum0, sum1));
+    for (; i < dim; ++i) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma"))) inline float dot(const float* a, const float* b, size_t dim) {
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+    }
+    for (; i + 8 <= dim; i += 8) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+    }
+    float sum = horizontalSum(_mm256_add_ps(sum0, sum1));
+    for (; i < dim; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma"))) inline void dotBlock(const float* query, const float* base, size_t count, size_t dim, float* out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = dot(query, base + i * dim, dim);
+    }
+}
+
+__attribute__((target("avx2,fma"))) inline void squaredL2Block(const float* query, const float* base, size_t count, size_t dim, float* out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = squaredL2(query, base + i * dim, dim);
+    }
+}
+
+// out[q * stride + r] = queries[q] . base[r] for a 4 query x 3 row tile (12 accumulators + 3 rows + 1 query = 16 ymm)
+__attribute__((target("avx2,fma"))) inline void dotKernel(const float* queries, const float* base, size_t dim, float* out, size_t stride) {
+    __m256 acc[4][3];
+#pragma GCC unroll 4
+    for (size_t q = 0; q < 4; ++q) {
+#pragma GCC unroll 3
+        for (size_t r = 0; r < 3; ++r) {
+            acc[q][r] = _mm256_setzero_ps();
+        }
+    }
+    size_t i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        __m256 rows[3];
+#pragma GCC unroll 3
+        for (size_t r = 0; r < 3; ++r) {
+            rows[r] = _mm256_loadu_ps(base + r * dim + i);
+        }
+#pragma GCC unroll 4
+        for (size_t q = 0; q < 4; ++q) {
+            __m256 query = _mm256_loadu_ps(queries + q * dim + i);
+#pragma GCC unroll 3
+            for (size_t r = 0; r < 3; ++r) {
+                acc[q][r] = _mm256_fmadd_ps(query, rows[r], acc[q][r]);
+            }
+        }
+    }
+    for (size_t q = 0; q < 4; ++q) {
+        for (size_t r = 0; r < 3; ++r) {
+            float sum = horizontalSum(acc[q][r]);
+            for (size_t j = i; j < dim; ++j) {
+                sum += queries[q * dim + j] * base[r * dim + j];
+            }
+            out[q * stride + r] = sum;
+        }
+    }
+}
+
+__attribute__((target("avx2,fma"))) inline void dotTile(const float* queries, size_t queryCount, const float* base, size_t count, size_t dim, float* out) {
+    size_t q = 0;
+    for (; q + 4 <= queryCount; q += 4) {
+        size_t r = 0;
+        for (; r + 3 <= count; r += 3) {
+            dotKernel(queries + q * dim, base + r * dim, dim, out + q * count + r, count);
+        }
+        for (; r < count; ++r) {
+            for (size_t t = q; t < q + 4; ++t) {
+                out[t * count + r] = dot(queries + t * dim, base + r * dim, dim);
+            }
+        }
+    }
+    for (; q < queryCount; ++q) {
+        dotBlock(queries + q * dim, base, count, dim, out + q * count);
+    }
+}
+
+// int8 dot product : sign extend 16 bytes to int16 and multiply-add pairs into int32 (no saturation)
+__attribute__((target("avx2,fma"))) inline int32_t dotInt8(const int8_t* a, const int8_t* b, size_t dim) {
+    __m256i sum = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m256i x = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i y = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(x, y));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    int32_t total = _mm_cvtsi128_si32(half);
+    for (; i < dim; ++i) {
+        total += int32_t(a[i]) * int32_t(b[i]);
+    }
+    return total;
+}
+
+__attribute__((target("avx2,fma,f16c"))) inline float squaredL2Half(const float* query, const uint16_t* row, size_t dim) {
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(query + i), _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i))));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(query + i + 8), _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i + 8))));
+        sum0 = _mm256_fmadd_ps(d0, d0, sum0);
+        sum1 = _mm256_fmadd_ps(d1, d1, sum1);
+    }
+    for (; i + 8 <= dim; i += 8) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(query + i), _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i))));
+        sum0 = _mm256_fmadd_ps(d0, d0, sum0);
+    }
+    float sum = horizontalSum(_mm256_add_ps(sum0, sum1));
+    for (; i < dim; ++i) {
+        float d = query[i] - scalar::halfToFloat(row[i]);
+        sum += d * d;
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma,f16c"))) inline void toHalf(const float* in, uint16_t* out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), half);
+    }
+    for (; i < count; ++i) {
+        out[i] = scalar::floatToHalf(in[i]);
+    }
+}
+
+// popcount of 256 bits at a time : pshufb looks up the bit count of each nibble, psadbw sums the bytes per uint64
+__attribute__((target("avx2,fma,popcnt"))) inline uint32_t hamming(const uint64_t* a, const uint64_t* b, size_t words) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i sum = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                     _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(x, nibble)),
+                                         _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble)));
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+    }
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    uint64_t total = uint64_t(_mm_cvtsi128_si64(half)) + uint64_t(_mm_extract_epi64(half, 1));
+    for (; i < words; ++i) {
+        total += uint64_t(_mm_popcnt_u64(a[i] ^ b[i]));
+    }
+    return static_cast<uint32_t>(total);
+}
+
+__attribute__((target("avx2,fma,popcnt"))) inline void hammingBlock(const uint64_t* query, const uint64_t* codes, size_t count, size_t words, uint32_t* out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = hamming(query, codes + i * words, words);
+    }
+}
+
+// 32 table lookups per subspace with one pshufb : lane 0 looks up the low nibbles, lane 1 the high ones
+__attribute__((target("avx2,fma"))) inline void lookupAdd4(const uint8_t* codes, const uint8_t* tables, size_t subspaces, uint16_t* out) {
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_setzero_si256();
+    __m256i high = _mm256_setzero_si256();
+    for (size_t s = 0; s < subspaces; ++s) {
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + s * 16));
+        __m256i indices = _mm256_and_si256(_mm256_set_m128i(_mm_srli_epi16(packed, 4), packed), nibble);
+        __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tables + s * 16)));
+        __m256i values = _mm256_shuffle_epi8(table, indices);
+        low = _mm256_adds_epu16(low, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(values)));
+        high = _mm256_adds_epu16(high, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(values, 1)));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), low);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 16), high);
+}
+
+}
+
+namespace avx512 {
+
+__attribute__((target("avx512f"))) inline float horizontalSum(__m512 v) {
+    // fold 512 -> 128 bits with lane shuffles, then reduce the last 4 floats
+    // (the all-ones mask variants avoid GCC's bogus -Wuninitialized on the unmasked intrinsics)
+    const __mmask16 all = 0xffff;
+    v = _mm512_add_ps(v, _mm512_mask_shuffle_f32x4(v, all, v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm512_add_ps(v, _mm512_mask_shuffle_f32x4(v, all, v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    __m128 sum = _mm512_mask_extractf32x4_ps(_mm_setzero_ps(), 0xf, v, 0);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx512f"))) inline float squaredL2(const float* a, const float* b, size_t dim) {
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= dim; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        sum0 = _mm512_fmadd_ps(d0, d0, sum0);
+        sum1 = _mm512_fmadd_ps(d1, d1, sum1);
+    }
+    for (; i < dim; i += 16) {
+        // masked loads cover the tail
+        __mmask16 mask = dim - i >= 16 ? __mmask16(0xffff) : __mmask16((1u << (dim - i)) - 1);
+        __m512 d0 = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+        sum0 = _mm512_fmadd_ps(d0, d0, sum0);
+    }
+    return horizontalSum(_mm512_add_ps(sum0, sum1));
+}
+
+__attribute__((target("avx512f"))) inline float dot(const float* a, const float* b, size_t dim) {
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= dim; i += 32) {
+        sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), sum0);
+        sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), sum1);
+    }
+    for (; i < dim; i += 16) {
+        __mmask16 mask = dim - i >= 16 ? __mmask16(0xffff) : __mmask16((1u << (dim - i)) - 1);
+        sum0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), sum0);
+    }
+    return horizontalSum(_mm512_add_ps(sum0, sum1));
+}
+
+__attribute__((target("avx512f"))) inline void dotBlock(const float* query, const float* base, size_t count, size_t dim, float* out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = dot(query, base + i * dim, dim);
+    }
+}
+
+__attribute__((target("avx512f"))) inline void squaredL2Block(const float* query, const float* base, size_t count, size_t dim, float* out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = squaredL2(query, base + i * dim, dim);
+    }
+}
+
+// out[q * stride + r] = queries[q] . base[r] for a 4 query x 4 row tile (masked loads cover the dim tail)
+__attribute__((target("avx512f"))) inline void dotKernel(const float* queries, const float* base, size_t dim, float* out, size_t stride) {
+    __m512 acc[4][4];
+#pragma GCC unroll 4
+    for (size_t q = 0; q < 4; ++q) {
+#pragma GCC unroll 4
+        for (size_t r = 0; r < 4; ++r) {
+            acc[q][r] = _mm512_setzero_ps();
+        }
+    }
+    for (size_t i = 0; i < dim; i += 16) {
+        __mmask16 mask = dim - i >= 16 ? __mmask16(0xffff) : __mmask16((1u << (dim - i)) - 1);
+        __m512 rows[4];
+#pragma GCC unroll 4
+        for (size_t r = 0; r < 4; ++r) {
+            rows[r] = _mm512_maskz_loadu_ps(mask, base + r * dim + i);
+        }
+#pragma GCC unroll 4
+        for (size_t q = 0; q < 4; ++q) {
+            __m512 query = _mm512_maskz_loadu_ps(mask, queries + q * dim + i);
+#pragma GCC unroll 4
+            for (size_t r = 0; r < 4; ++r) {
+                acc[q][r] = _mm512_fmadd_ps(query, rows[r], acc[q][r]);
+            }
+        }
+    }
+    for (size_t q = 0; q < 4; ++q) {
+        for (size_t r = 0; r < 4; ++r) {
+            out[q * stride + r] = horizontalSum(acc[q][r]);
+        }
+    }
+}
+
+__attribute__((target("avx512f"))) inline void dotTile(const float* queries, size_t queryCount, const float* base, size_t count, size_t dim, float* out) {
+    size_t q = 0;
+    for (; q + 4 <= queryCount; q += 4) {
+        size_t r = 0;
+        for (; r + 4 <= count; r += 4) {
+            dotKernel(queries + q * dim, base + r * dim, dim, out + q * count + r, count);
+        }
+        for (; r < count; ++r) {
+            for (size_t t = q; t < q + 4; ++t) {
+                out[t * count + r] = dot(queries + t * dim, base + r * dim, dim);
+            }
+        }
+    }
+    for (; q < queryCount; ++q) {
+        dotBlock(queries + q * dim, base, count, dim, out + q * count);
+    }
+}
+
+// VPOPCNTDQ : one vpopcntq per 8 words (masked loads cover the tail)
+__attribute__((target("avx2,avx512f,avx512vpopcntdq"))) inline uint32_t hamming(const uint64_t* a, const uint64_t* b, size_t words) {
+    __m512i sum = _mm512_setzero_si512();
+    for (size_t i = 0; i < words; i += 8) {
+        __mmask8 mask = words - i >= 8 ? __mmask8(0xff) : __mmask8((1u << (words - i)) - 1);
+        __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi64(mask, a + i), _mm512_maskz_loadu_epi64(mask, b + i));
+        sum = _mm512_add_epi64(sum, _mm512_popcnt_epi64(x));
+    }
+    // masked extracts, as in horizontalSum
+    __m256i half = _mm256_add_epi64(_mm512_mask_extracti64x4_epi64(_mm256_setzero_si256(), 0xf, sum, 0),
+                                    _mm512_mask_extracti64x4_epi64(_mm256_setzero_si256(), 0xf, sum, 1));
+    __m128i quarter = _mm_add_epi64(_mm256_castsi256_si128(half), _mm256_extracti128_si256(half, 1));
+    return static_cast<uint32_t>(_mm_cvtsi128_si64(quarter) + _mm_extract_epi64(quarter, 1));
+}
+
+__attribute__((target("avx2,avx512f,avx512vpopcntdq"))) inline void hammingBlock(const uint64_t* query, const uint64_t* codes, size_t count, size_t words, uint32_t* out) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = hamming(query, codes + i * words, words);
+    }
+}
+
+// VNNI : vpdpwssd multiplies 32 sign extended int16 pairs and accumulates them into 16 int32 lanes in one step
+__attribute__((target("avx2,avx512f,avx512bw,avx512vl,avx512vnni"))) inline int32_t dotInt8(const int8_t* a, const int8_t* b, size_t dim) {
+    __m512i sum = _mm512_setzero_si512();
+    for (size_t i = 0; i < dim; i += 32) {
+        __mmask32 mask = dim - i >= 32 ? __mmask32(0xffffffff) : __mmask32((1u << (dim - i)) - 1);
+        __m512i x = _mm512_cvtepi8_epi16(_mm256_maskz_loadu_epi8(mask, a + i));
+        __m512i y = _mm512_cvtepi8_epi16(_mm256_maskz_loadu_epi8(mask, b + i));
+        sum = _mm512_dpwssd_epi32(sum, x, y);
+    }
+    // masked extracts, as in horizontalSum
+    __m256i half = _mm256_add_epi32(_mm512_mask_extracti64x4_epi64(_mm256_setzero_si256(), 0xf, sum, 0),
+                                    _mm512_mask_extracti64x4_epi64(_mm256_setzero_si256(), 0xf, sum, 1));
+    __m128i quarter = _mm_add_epi32(_mm256_castsi256_si128(half), _mm256_extracti128_si256(half, 1));
+    quarter = _mm_add_epi32(quarter, _mm_shuffle_epi32(quarter, _MM_SHUFFLE(1, 0, 3, 2)));
+    quarter = _mm_add_epi32(quarter, _mm_shuffle_epi32(quarter, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(quarter);
+}
+
+__attribute__((target("avx512f"))) inline float squaredL2Half(const float* query, const uint16_t* row, size_t dim) {
+    __m512 sum = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m512 h = _mm512_mask_cvtph_ps(_mm512_setzero_ps(), 0xffff, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i)));
+        __m512 d = _mm512_sub_ps(_mm512_loadu_ps(query + i), h);
+        sum = _mm512_fmadd_ps(d, d, sum);
+    }
+    float total = horizontalSum(sum);
+    for (; i < dim; ++i) {
+        float d = query[i] - scalar::halfToFloat(row[i]);
+        total += d * d;
+    }
+    return total;
+}
+
+}
+#endif
+
+inline float squaredL2(const float* a, const float* b, size_t dim) {
+#ifdef SELECT_K_X86_DISPATCH
+    switch (level()) {
+    case Level::Avx512: return avx512::squaredL2(a, b, dim);
+    case Level::Avx2: return avx2::squaredL2(a, b, dim);
+    default: break;
+    }
+#endif
+    return scalar::squaredL2(a, b, dim);
+}
+
+// out[i] = ||query - base[i]||^2 for the count rows (of dim floats) of base
+inline void squaredL2Block(const float* query, const float* base, size_t count, size_t dim, float* out) {
+#ifdef SELECT_K_X86_DISPATCH
+    switch (level()) {
+    case Level::Avx512: avx512::squaredL2Block(query, base, count, dim, out); return;
+    case Level::Avx2: avx2::squaredL2Block(query, base, count, dim, out); return;
+    default: break;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = scalar::squaredL2(query, base + i * dim, dim);
+    }
+}
+
+inline float dot(const float* a, const float* b, size_t dim) {
+#ifdef SELECT_K_X86_DISPATCH
+    switch (level()) {
+    case Level::Avx512: return avx512::dot(a, b, dim);
+    case Level::Avx2: return avx2::dot(a, b, dim);
+    default: break;
+    }
+#endif
+    return scalar::dot(a, b, dim);
+}
+
+// out[i] = query . base[i] for the count rows (of dim floats) of base
+inline void dotBlock(const float* query, const float* base, size_t count, size_t dim, float* out) {
+#ifdef SELECT_K_X86_DISPATCH
+    switch (level()) {
+    case Level::Avx512: avx512::dotBlock(query, base, count, dim, out); return;
+    case Level::Avx2: avx2::dotBlock(query, base, count, dim, out); return;
+    default: break;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = scalar::dot(query, base + i * dim, dim);
+    }
+}
+
+// out[q * count + i] = queries[q] . base[i] for the queryCount x count tile (both row major, dim floats per row)
+inline void dotTile(const float* queries, size_t queryCount, const float* base, size_t count, size_t dim, float* out) {
+#ifdef SELECT_K_X86_DISPATCH
+    switch (level()) {
+    case Level::Avx512: avx512::dotTile(queries, queryCount, base, count, dim, out); return;
+    case Level::Avx2: avx2::dotTile(queries, queryCount, base, count, dim, out); return;
+    default: break;
+    }
+#endif
+    for (size_t q = 0; q < queryCount; ++q) {
+        for (size_t i = 0; i < count; ++i) {
+            out[q * count + i] = scalar::dot(queries + q * dim, base + i * dim, dim);
+        }
+    }
+}
+
+// out[i] (i < 32) = sum of tables[s * 16 + code(i, s)] over the subspaces, codes packed as described above
+inline void lookupAdd4(const uint8_t* codes, const uint8_t* tables, size_t subspaces, uint16_t* out) {
+#ifdef SELECT_K_X86_DISPATCH
+    if (level() != Level::Scalar) {
+        avx2::lookupAdd4(codes, tables, subspaces, out);
+        return;
+    }
+#endif
+    scalar::lookupAdd4(codes, tables, subspaces, out);
+}
+
+// a . b over int8 vectors (exact int32)
+inline int32_t dotInt8(const int8_t* a, const int8_t* b, size_t dim) {
+#ifdef SELECT_K_X86_DISPATCH
+    if (hasVnni()) { return avx512::dotInt8(a, b, dim); }
+    if (level() != Level::Scalar) { return avx2::dotInt8(a, b, dim); }
+#endif
+    return scalar::dotInt8(a, b, dim);
+}
+
+// ||query - row||^2 for a float query and an fp16 row
+inline float squaredL2Half(const float* query, const uint16_t* row, size_t dim) {
+#ifdef SELECT_K_X86_DISPATCH
+    if (hasF16c()) {
+        return level() == Level::Avx512 ? avx512::squaredL2Half(query, row, dim) : avx2::squaredL2Half(query, row, dim);
+    }
+#endif
+    return scalar::squaredL2Half(query, row, dim);
+}
+
+inline void toHalf(const float* in, uint16_t* out, size_t count) {
+#ifdef SELECT_K_X86_DISPATCH
+    if (hasF16c()) {
+        avx2::toHalf(in, out, count);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = scalar::floatToHalf(in[i]);
+    }
+}
+
+inline void toFloat(const uint16_t* in, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = scalar::halfToFloat(in[i]);
+    }
+}
+
+// out[i] = hamming distance between query and code i (codes of words uint64s, packed back to back)
+inline void hammingBlock(const uint64_t* query, const uint64_t* codes, size_t count, size_t words, uint32_t* out) {
+#ifdef SELECT_K_X86_DISPATCH
+    if (hasVpopcntdq()) {
+        avx512::hammingBlock(query, codes, count, words, out);
+        return;
+    }
+    if (level() != Level::Scalar) {
+        avx2::hammingBlock(query, codes, count, words, out);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = scalar::hamming(query, codes + i * words, words);
+    }
+}
+
+// scales each of the count rows of data to unit L2 norm in place (all zero rows are left as is)
+inline void normalize(float* data, size_t count, size_t dim) {
+    for (size_t i = 0; i < count; ++i) {
+        float* row = data + i * dim;
+        float norm = std::sqrt(dot(row, row, dim));
+        if (norm > 0) {
+            float scale = 1.0f / norm;
+            for (size_t j = 0; j < dim; ++j) {
+                row[j] *= scale;
+            }
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,146 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : delimited text helpers (SIMD byte scanner, zero-copy line / field views, numeric parse)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      k::Top<k::text::LineView, double> selector(k, [](const k::text::LineView& line) {
+ *          double score = 0;
+ *          k::text::parseNumber(k::text::field(line, ',', 2), score);
+ *          return score;
+ *      });
+ *      k::text::forEachLine(data, data + size, true, [&](k::text::LineView line) { selector.offer(line); });
+ *
+ *  Lines and fields are std::string_view into the caller's buffer - nothing is copied.
+ *  Fields are split on the delimiter only (quoted delimiters are not interpreted).
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <cstring>
+#include <cstddef>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+namespace k {
+namespace text {
+
+using LineView = std::string_view;
+
+// first occurrence of c in [begin, end) or end
+inline const char* findByte(const char* begin, const char* end, char c) {
+    const char* p = begin;
+#if defined(__AVX2__)
+    const __m256i needle = _mm256_set1_epi8(c);
+    for (; p + 32 <= end; p += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i needle16 = _mm_set1_epi8(c);
+    for (; p + 16 <= end; p += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle16)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; p < end; ++p) {
+        if (*p == c) { return p; }
+    }
+    return end;
+}
+
+/**
+ * Calls fn(LineView) for every line in [begin, end) (line terminator and a trailing '\r' excluded).
+ * If final is false an unterminated last line is not consumed.
+ * Returns the start of the unconsumed tail (end if everything was consumed).
+ */
+template <typename LineFunction>
+const char* forEachLine(const char* begin, const char* end, bool final, LineFunction&& fn) {
+    const char* lineStart = begin;
+    while (lineStart < end) {
+        const char* newline = findByte(lineStart, end, '\n');
+        if (newline == end && !final) {
+            return lineStart;
+        }
+        const char* lineEnd = newline;
+        if (lineEnd > lineStart && lineEnd[-1] == '\r') {
+            --lineEnd;
+        }
+        fn(LineView(lineStart, static_cast<size_t>(lineEnd - lineStart)));
+        lineStart = newline == end ? end : newline + 1;
+    }
+    return end;
+}
+
+/**
+ * Splits [begin, end) into (at most) parts contiguous ranges that each start at a line start.
+ * Returns the range boundaries: range i is [boundaries[i], boundaries[i + 1]).
+ */
+inline std::vector<const char*> lineChunks(const char* begin, const char* end, size_t parts) {
+    std::vector<const char*> boundaries { begin };
+    const size_t size = static_cast<size_t>(end - begin);
+    for (size_t i = 1; i < parts; ++i) {
+        const char* split = begin + size * i / parts;
+        if (split <= boundaries.back()) { continue; }
+        const char* newline = findByte(split - 1, end, '\n');
+        if (newline == end || newline + 1 == end) { break; }
+        boundaries.push_back(newline + 1);
+    }
+    boundaries.push_back(end);
+    return boundaries;
+}
+
+// the column-th (0 based) field of a line, empty if the line has fewer fields
+inline std::string_view field(LineView line, char delimiter, size_t column) {
+    const char* p = line.data();
+    const char* end = p + line.size();
+    for (size_t i = 0; i < column; ++i) {
+        p = findByte(p, end, delimiter);
+        if (p == end) { return {}; }
+        ++p;
+    }
+    return std::string_view(p, static_cast<size_t>(findByte(p, end, delimiter) - p));
+}
+
+// parses a number (surrounding blanks allowed), returns false if the text is not entirely numeric
+template <typename Number>
+bool parseNumber(std::string_view text, Number& value) {
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    while (begin < end && (*begin == ' ' || *begin == '\t')) { ++begin; }
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t')) { --end; }
+    if (begin < end && *begin == '+') { ++begin; }
+    if (begin == end) { return false; }
+    auto [ptr, error] = std::from_chars(begin, end, value);
+    return error == std::errc() && ptr == end;
+}
+
+}
+}
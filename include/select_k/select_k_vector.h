@@ -0,0 +1,339 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : exact k-nearest neighbours over dense float vectors
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      // base : count x dim floats, row major, contiguous (not copied - must outlive the index)
+ *      k::Nearest nearest(base.data(), count, dim);
+ *
+ *      std::vector<k::Nearest::Neighbor> neighbors;      // (row index, squared L2 distance)
+ *      nearest.search(std::back_inserter(neighbors), query, 10);
+ *
+ *      // maximum inner product / cosine similarity, ranked with a k::Top style selector
+ *      k::Nearest similar(base.data(), count, dim, k::Metric::Cosine);
+ *
+ *      // many queries at once (queryCount x dim floats, row major) : results[q] holds the neighbours of query q
+ *      auto results = nearest.searchBatch(queries.data(), queryCount, 10);
+ *
+ *      // only rows set in an allow-list bitmap (select_k_filter.h)
+ *      nearest.search(std::back_inserter(neighbors), query, 10, k::Filter(allowed));
+ *
+ *      // the score of single rows (prepare normalizes a cosine query once, into the scratch vector)
+ *      std::vector<float> scratch;
+ *      const float* prepared = similar.prepare(query, scratch);
+ *      float similarity = similar.score(prepared, row);
+ *
+ *  Scores are computed a block of rows at a time with the SIMD kernels in select_k_simd.h and fed straight
+ *  into a bounded selector (only rows better than the current K-th score are offered).
+ *
+ *  searchBatch works like a blocked matrix multiply : a tile of kQueryTile queries is scored against a block of
+ *  kBlock rows with simd::dotTile (squared L2 as ||q||^2 + ||x||^2 - 2 q.x), so every row block pulled into cache
+ *  is reused by all the queries in the tile, and each query's row of the tile feeds that query's own selector.
+ *  Query tiles are spread over threads; L2 distances of the final K are recomputed exactly.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include "select_k/select_k_filter.h"
+#include "select_k/select_k_simd.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+namespace k {
+
+enum class Metric {
+    L2,             // squared euclidean distance, smaller is nearer (k::Bottom)
+    InnerProduct,   // maximum inner product, larger is nearer (k::Top)
+    Cosine,         // cosine similarity, larger is nearer (k::Top)
+};
+
+class Nearest {
+public:
+    // (row index, score) - squared distance for Metric::L2, similarity otherwise
+    using Neighbor = std::pair<size_t, float>;
+    using NearestSelector = Select<size_t, float, std::less<float>>;
+    using SimilarSelector = Select<size_t, float, std::greater<float>>;
+
+    // rows whose scores are computed in one kernel call
+    static constexpr size_t kBlock = 256;
+    // queries scored together against each row block by searchBatch
+    static constexpr size_t kQueryTile = 32;
+
+    /**
+     * For Metric::Cosine the inverse row norms are computed once here, unless normalized says the rows are already
+     * unit length (see simd::normalize() to pre-normalize at ingest) - then cosine is scored as a plain inner product.
+     * norms (count L2 row norms, e.g. k::Dataset::norms()) are used instead of reading every row to compute them,
+     * here and by searchBatch (kept by reference).
+     */
+    Nearest(const float* data, size_t count, size_t dim, Metric metric = Metric::L2, bool normalized = false,
+            const float* norms = nullptr)
+        : data_(data), count_(count), dim_(dim), metric_(metric), norms_(norms) {
+        if (metric_ == Metric::Cosine && !normalized) {
+            inverseNorms_.resize(count_);
+            for (size_t i = 0; i < count_; ++i) {
+                float norm = norms_ != nullptr ? norms_[i] : std::sqrt(simd::dot(row(i), row(i), dim_));
+                inverseNorms_[i] = norm > 0 ? 1.0f / norm : 0.0f;
+            }
+        }
+    }
+
+    size_t count() const { return count_; }
+    size_t dim() const { return dim_; }
+    Metric metric() const { return metric_; }
+    const float* row(size_t index) const { return data_ + index * dim_; }
+
+    // the K nearest rows to query (among the rows filter allows) as Neighbor (index, score), nearest first
+    template <typename OutputIterator>
+    size_t search(OutputIterator out, const float* query, size_t k, const Filter& filter = {}) const {
+        if (metric_ == Metric::L2) {
+            return select<std::less<float>>(query, k, filter).scoredResults(out, true);
+        }
+        std::vector<float> normalized;
+        return select<std::greater<float>>(prepare(query, normalized), k, filter).scoredResults(out, true);
+    }
+
+    /**
+     * the K nearest rows to each of queryCount queries (row major, dim floats each) : results[q] is nearest first
+     * threads = 0 uses one thread per core
+     */
+    std::vector<std::vector<Neighbor>> searchBatch(const float* queries, size_t queryCount, size_t k, size_t threads = 0,
+                                                   const Filter& filter = {}) const {
+        std::vector<std::vector<Neighbor>> results(queryCount);
+        if (queryCount == 0) { return results; }
+        std::vector<float> normalized;
+        if (metric_ == Metric::Cosine) {
+            normalized.assign(queries, queries + queryCount * dim_);
+            simd::normalize(normalized.data(), queryCount, dim_);
+            queries = normalized.data();
+        }
+        std::vector<float> rowNorms;
+        if (metric_ == Metric::L2) {
+            rowNorms.resize(count_);
+            for (size_t i = 0; i < count_; ++i) {
+                rowNorms[i] = norms_ != nullptr ? norms_[i] * norms_[i] : simd::dot(row(i), row(i), dim_);
+            }
+        }
+
+        const size_t tiles = (queryCount + kQueryTile - 1) / kQueryTile;
+        if (threads == 0) {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        threads = std::min(threads, tiles);
+        auto searchTiles = [&](size_t worker) {
+            for (size_t tile = worker; tile < tiles; tile += threads) {
+                const size_t first = tile * kQueryTile;
+                const size_t size = std::min(kQueryTile, queryCount - first);
+                if (metric_ == Metric::L2) {
+                    searchTile<std::less<float>>(queries + first * dim_, size, k, rowNorms, filter, results.data() + first);
+                } else {
+                    searchTile<std::greater<float>>(queries + first * dim_, size, k, rowNorms, filter, results.data() + first);
+                }
+            }
+        };
+        if (threads == 1) {
+            searchTiles(0);
+        } else {
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (size_t worker = 0; worker < threads; ++worker) {
+                workers.emplace_back(searchTiles, worker);
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+        return results;
+    }
+
+    /**
+     * the query as scored against the rows (a unit length copy in normalized for Metric::Cosine) - score() takes
+     * the returned pointer, so one query scored against many rows is normalized once
+     */
+    const float* prepare(const float* query, std::vector<float>& normalized) const {
+        if (metric_ != Metric::Cosine) { return query; }
+        normalized.assign(query, query + dim_);
+        simd::normalize(normalized.data(), 1, dim_);
+        return normalized.data();
+    }
+
+    // score of one row for a query returned by prepare() (an unprepared cosine query gets an unnormalized score)
+    float score(const float* query, size_t index) const {
+        switch (metric_) {
+        case Metric::L2:
+            return simd::squaredL2(query, row(index), dim_);
+        case Metric::InnerProduct:
+            return simd::dot(query, row(index), dim_);
+        case Metric::Cosine:
+            return simd::dot(query, row(index), dim_) * (inverseNorms_.empty() ? 1.0f : inverseNorms_[index]);
+        }
+        return 0;
+    }
+
+protected:
+    // out[i] = score of row first + i for a prepared query
+    void scoreBlock(const float* query, size_t first, size_t rows, float* out) const {
+        if (metric_ == Metric::L2) {
+            simd::squaredL2Block(query, row(first), rows, dim_, out);
+            return;
+        }
+        simd::dotBlock(query, row(first), rows, dim_, out);
+        if (!inverseNorms_.empty()) {
+            for (size_t i = 0; i < rows; ++i) {
+                out[i] *= inverseNorms_[first + i];
+            }
+        }
+    }
+
+    // selector (Compare decides nearer) holding the K best allowed rows for a prepared query
+    template <class Compare>
+    Select<size_t, float, Compare> select(const float* query, size_t k, const Filter& filter) const {
+        Select<size_t, float, Compare> selector(k, [this, query](const size_t& index) { return score(query, index); });
+        if (k == 0) { return selector; }
+        float scores[kBlock];
+        if (filter.all()) {
+            for (size_t first = 0; first < count_; first += kBlock) {
+                const size_t rows = std::min(kBlock, count_ - first);
+                scoreBlock(query, first, rows, scores);
+                offerBlock(selector, first, scores, rows);
+            }
+            return selector;
+        }
+        // 64 rows per filter word : empty words are skipped, full ones go through the block kernel
+        Compare compare;
+        for (size_t index = 0; index < Filter::words(count_); ++index) {
+            const uint64_t mask = Filter::mask(index, count_);
+            uint64_t bits = filter.word(index) & mask;
+            const size_t first = index * 64;
+            if (bits == mask) {
+                scoreBlock(query, first, std::min<size_t>(64, count_ - first), scores);
+                offerBlock(selector, first, scores, std::min<size_t>(64, count_ - first));
+                continue;
+            }
+            for (; bits != 0; bits &= bits - 1) {
+                const size_t row = first + static_cast<size_t>(__builtin_ctzll(bits));
+                const float s = score(query, row);
+                if (!selector.full() || compare(s, selector.threshold())) {
+                    selector.offerScored(row, s);
+                }
+            }
+        }
+        return selector;
+    }
+
+    // one tile of prepared queries : scores (kQueryTile x kBlock) are computed with dotTile and fed row by row to
+    // the per-query selectors (rowNorms holds the squared row norms for Metric::L2)
+    template <class Compare>
+    void searchTile(const float* queries, size_t size, size_t k, const std::vector<float>& rowNorms, const Filter& filter,
+                    std::vector<Neighbor>* results) const {
+        using TileSelector = Select<size_t, float, Compare>;
+        std::vector<TileSelector> selectors;
+        selectors.reserve(size);
+        std::vector<float> queryNorms(size);
+        for (size_t q = 0; q < size; ++q) {
+            const float* query = queries + q * dim_;
+            selectors.emplace_back(k, [this, query](const size_t& index) { return score(query, index); });
+            queryNorms[q] = simd::dot(query, query, dim_);
+        }
+        if (k > 0) {
+            std::vector<float> scores(size * kBlock);
+            for (size_t first = 0; first < count_; first += kBlock) {
+                const size_t rows = std::min(kBlock, count_ - first);
+                if (!filter.all() && !anyAllowed(filter, first, rows)) { continue; }
+                simd::dotTile(queries, size, row(first), rows, dim_, scores.data());
+                for (size_t q = 0; q < size; ++q) {
+                    float* tile = scores.data() + q * rows;
+                    if (metric_ == Metric::L2) {
+                        for (size_t i = 0; i < rows; ++i) {
+                            tile[i] = std::max(0.0f, queryNorms[q] + rowNorms[first + i] - 2 * tile[i]);
+                        }
+                    } else if (!inverseNorms_.empty()) {
+                        for (size_t i = 0; i < rows; ++i) {
+                            tile[i] *= inverseNorms_[first + i];
+                        }
+                    }
+                    if (filter.all()) {
+                        offerBlock(selectors[q], first, tile, rows);
+                    } else {
+                        offerAllowed(selectors[q], first, tile, rows, filter);
+                    }
+                }
+            }
+        }
+        for (size_t q = 0; q < size; ++q) {
+            std::vector<Neighbor>& neighbors = results[q];
+            selectors[q].scoredResults(std::back_inserter(neighbors), true);
+            if (metric_ == Metric::L2) {
+                // the expansion cancels badly for near duplicates : rescore the K winners exactly
+                for (auto& neighbor : neighbors) {
+                    neighbor.second = simd::squaredL2(queries + q * dim_, row(neighbor.first), dim_);
+                }
+                std::stable_sort(neighbors.begin(), neighbors.end(),
+                                 [](const Neighbor& a, const Neighbor& b) { return a.second < b.second; });
+            }
+        }
+    }
+
+    template <typename Selector>
+    static void offerBlock(Selector& selector, size_t first, const float* scores, size_t rows) {
+        typename Selector::Compare compare;
+        size_t i = 0;
+        for (; i < rows && !selector.full(); ++i) {
+            selector.offerScored(first + i, scores[i]);
+        }
+        if (i == rows) { return; }
+        float threshold = selector.threshold();
+        for (; i < rows; ++i) {
+            if (compare(scores[i], threshold)) {
+                selector.offerScored(first + i, scores[i]);
+                threshold = selector.threshold();
+            }
+        }
+    }
+
+    // offerBlock for the rows filter allows
+    template <typename Selector>
+    static void offerAllowed(Selector& selector, size_t first, const float* scores, size_t rows, const Filter& filter) {
+        typename Selector::Compare compare;
+        for (size_t i = 0; i < rows; ++i) {
+            if (filter.allows(first + i) && (!selector.full() || compare(scores[i], selector.threshold()))) {
+                selector.offerScored(first + i, scores[i]);
+            }
+        }
+    }
+
+    // whether filter allows any of rows [first, first + rows) (first is a multiple of 64)
+    static bool anyAllowed(const Filter& filter, size_t first, size_t rows) {
+        for (size_t index = first / 64; index < Filter::words(first + rows); ++index) {
+            if ((filter.word(index) & Filter::mask(index, first + rows)) != 0) { return true; }
+        }
+        return false;
+    }
+
+    const float* data_;
+    size_t count_;
+    size_t dim_;
+    Metric metric_;
+    const float* norms_;
+    std::vector<float> inverseNorms_;
+};
+
+}
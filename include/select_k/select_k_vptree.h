@@ -0,0 +1,204 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  Select-K : vantage-point tree for k-nearest neighbours under any metric
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ * Sample Usage:
+ *      // the metric must satisfy the triangle inequality (edit distance, L1, L2 - but not squared L2 ...)
+ *      k::VpTree<std::string, int> tree(words.begin(), words.end(), editDistance);
+ *
+ *      std::vector<k::VpTree<std::string, int>::Neighbor> neighbors;   // (item index, distance), nearest first
+ *      tree.search(std::back_inserter(neighbors), "kitten", 3);
+ *
+ *      auto results = tree.searchBatch(queries.begin(), queries.end(), 3);   // results[q] : neighbours of queries[q]
+ *
+ *  The tree is flattened into one array of nodes. The node covering positions [begin, end) keeps its vantage point
+ *  at begin along with the median distance (radius) from it to the rest : the inside subtree [begin + 1, mid) is
+ *  no farther than radius from the vantage point, the outside subtree [mid, end) no nearer. Subtrees of at most
+ *  kLeafSize items are scanned linearly.
+ *
+ *  With tau the K-th best distance held by the selector, the triangle inequality lets a query at distance d from
+ *  the vantage point skip the inside subtree when d - radius >= tau and the outside one when radius - d >= tau.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+
+#pragma once
+#include "select_k/select_k.h"
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+namespace k {
+
+template <typename T, typename DistanceType>
+class VpTree {
+public:
+    using Item = T;
+    using Distance = DistanceType;
+    using MetricFunction = std::function<Distance(const T&, const T&)>;
+    // (item index in the input, distance)
+    using Neighbor = std::pair<size_t, Distance>;
+    // selects node positions
+    using Selector = Select<size_t, Distance, std::less<Distance>>;
+
+    static constexpr size_t kLeafSize = 8;
+
+    struct Node {
+        T item;
+        size_t id;          // index of the item in the input
+        Distance radius;    // median distance from this vantage point to the rest of its subtree (unused in leaves)
+    };
+
+    template <typename InputIterator>
+    VpTree(InputIterator begin, InputIterator end, MetricFunction metric) : metric_(std::move(metric)) {
+        for (size_t id = 0; begin != end; ++begin, ++id) {
+            nodes_.push_back(Node{*begin, id, Distance()});
+        }
+        std::vector<Distance> distances(nodes_.size());
+        std::mt19937_64 random(nodes_.size());
+        build(0, nodes_.size(), distances, random);
+    }
+
+    size_t count() const { return nodes_.size(); }
+    const MetricFunction& metric() const { return metric_; }
+
+    // the K nearest items to query as Neighbor (index, distance), nearest first
+    template <typename OutputIterator>
+    size_t search(OutputIterator out, const T& query, size_t k) const {
+        Selector selector = select(query, k);
+        std::vector<std::pair<size_t, Distance>> positions;
+        positions.reserve(selector.size());
+        selector.scoredResults(std::back_inserter(positions), true);
+        for (auto [position, distance] : positions) {
+            *out++ = Neighbor(nodes_[position].id, distance);
+        }
+        return positions.size();
+    }
+
+    /**
+     * the K nearest items to each query in [begin, end) (random access) : results[q] is nearest first
+     * threads = 0 uses one thread per core
+     */
+    template <typename RandomAccessIterator>
+    std::vector<std::vector<Neighbor>> searchBatch(RandomAccessIterator begin, RandomAccessIterator end, size_t k,
+                                                   size_t threads = 0) const {
+        const size_t queries = static_cast<size_t>(end - begin);
+        std::vector<std::vector<Neighbor>> results(queries);
+        if (threads == 0) {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        threads = std::max<size_t>(1, std::min(threads, queries));
+        auto searchQueries = [&](size_t worker) {
+            for (size_t q = worker; q < queries; q += threads) {
+                search(std::back_inserter(results[q]), begin[q], k);
+            }
+        };
+        if (threads == 1) {
+            searchQueries(0);
+        } else {
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (size_t worker = 0; worker < threads; ++worker) {
+                workers.emplace_back(searchQueries, worker);
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+        return results;
+    }
+
+    // selector of node positions holding the K nearest items to query, its scorer keeps a copy of query (later offer()s
+    // may outlive the argument)
+    Selector select(const T& query, size_t k) const {
+        Selector selector(k, [this, query](const size_t& position) { return metric_(query, nodes_[position].item); });
+        if (k > 0) {
+            search(selector, query, 0, nodes_.size());
+        }
+        return selector;
+    }
+
+    const Node& node(size_t position) const { return nodes_[position]; }
+
+protected:
+    void build(size_t begin, size_t end, std::vector<Distance>& distances, std::mt19937_64& random) {
+        if (end - begin <= kLeafSize) { return; }
+        // a random vantage point keeps the tree balanced on sorted or clustered inputs
+        std::swap(nodes_[begin], nodes_[begin + random() % (end - begin)]);
+        const T& vantage = nodes_[begin].item;
+        for (size_t i = begin + 1; i < end; ++i) {
+            distances[i] = metric_(vantage, nodes_[i].item);
+        }
+        const size_t mid = begin + 1 + (end - begin - 1) / 2;
+        // order positions (begin, end) by distance, moving the nodes along with their distances
+        std::vector<size_t> order(end - begin - 1);
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = begin + 1 + i;
+        }
+        std::nth_element(order.begin(), order.begin() + (mid - begin - 1), order.end(),
+                         [&distances](size_t a, size_t b) { return distances[a] < distances[b]; });
+        std::vector<Node> reordered;
+        reordered.reserve(order.size());
+        for (size_t position : order) {
+            reordered.push_back(std::move(nodes_[position]));
+        }
+        std::move(reordered.begin(), reordered.end(), nodes_.begin() + begin + 1);
+        nodes_[begin].radius = distances[order[mid - begin - 1]];
+        build(begin + 1, mid, distances, random);
+        build(mid, end, distances, random);
+    }
+
+    void search(Selector& selector, const T& query, size_t begin, size_t end) const {
+        if (begin >= end) { return; }
+        if (end - begin <= kLeafSize) {
+            for (size_t position = begin; position < end; ++position) {
+                offer(selector, position, metric_(query, nodes_[position].item));
+            }
+            return;
+        }
+        const Distance d = metric_(query, nodes_[begin].item);
+        offer(selector, begin, d);
+        const Distance radius = nodes_[begin].radius;
+        const size_t mid = begin + 1 + (end - begin - 1) / 2;
+        if (d < radius) {
+            search(selector, query, begin + 1, mid);
+            if (!selector.full() || radius - d < selector.threshold()) {
+                search(selector, query, mid, end);
+            }
+        } else {
+            search(selector, query, mid, end);
+            if (!selector.full() || d - radius < selector.threshold()) {
+                search(selector, query, begin + 1, mid);
+            }
+        }
+    }
+
+    static void offer(Selector& selector, size_t position, Distance d) {
+        if (!selector.full() || d < selector.threshold()) {
+            selector.offerScored(position, d);
+        }
+    }
+
+    MetricFunction metric_;
+    std::vector<Node> nodes_;
+};
+
+}
@@ -0,0 +1,142 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  select_k_bench : timings behind the speedups quoted for the index / kernel changes
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ *  $ select_k_bench                # every benchmark
+ *  $ select_k_bench batch          # only the named ones
+ *
+ *  Every timing is the best of kRepeats runs on one thread, over synthetic data from a fixed seed.
+ *
+ *      batch   k::Nearest::searchBatch vs one search() per query (100k x 128 floats, 500 queries, K = 10)
+ *      grid    k::Grid vs k::KdTree<int> build and query (2M uniform integer 2D points, 100k queries, K = 10)
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+#include "select_k/select_k_vector.h"
+#include "select_k/select_k_kdtree.h"
+#include "select_k/select_k_grid.h"
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// runs per timing (the best one is kept)
+constexpr size_t kRepeats = 3;
+
+// best wall clock seconds of kRepeats calls of fn
+double seconds(const std::function<void()>& fn) {
+    double best = 0;
+    for (size_t run = 0; run < kRepeats; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = run == 0 ? elapsed : std::min(best, elapsed);
+    }
+    return best;
+}
+
+std::vector<float> gaussianRows(size_t count, size_t dim, unsigned seed) {
+    std::mt19937 random(seed);
+    std::normal_distribution<float> normal;
+    std::vector<float> rows(count * dim);
+    for (auto& value : rows) {
+        value = normal(random);
+    }
+    return rows;
+}
+
+void benchBatch() {
+    const size_t count = 100000, dim = 128, queryCount = 500, k = 10;
+    std::vector<float> base = gaussianRows(count, dim, 1);
+    std::vector<float> queries = gaussianRows(queryCount, dim, 2);
+    k::Nearest nearest(base.data(), count, dim);
+    double single = seconds([&]() {
+        for (size_t q = 0; q < queryCount; ++q) {
+            std::vector<k::Nearest::Neighbor> neighbors;
+            nearest.search(std::back_inserter(neighbors), queries.data() + q * dim, k);
+        }
+    });
+    double batch = seconds([&]() { nearest.searchBatch(queries.data(), queryCount, k, 1); });
+    std::cout << "batch : " << queryCount << " queries x " << count << " x " << dim << " floats, K=" << k << std::endl;
+    std::cout << "  search() per query  " << single << " s" << std::endl;
+    std::cout << "  searchBatch()       " << batch << " s (" << single / batch << "x)" << std::endl;
+}
+
+void benchGrid() {
+    const size_t count = 2000000, queryCount = 100000, k = 10;
+    const int extent = 1 << 20;
+    std::mt19937 random(3);
+    std::uniform_int_distribution<int> coordinate(0, extent - 1);
+    std::vector<k::Grid::Point> points(count), queries(queryCount);
+    for (auto& point : points) {
+        point = {coordinate(random), coordinate(random)};
+    }
+    for (auto& query : queries) {
+        query = {coordinate(random), coordinate(random)};
+    }
+    std::vector<int> coordinates;
+    coordinates.reserve(2 * count);
+    for (auto [x, y] : points) {
+        coordinates.push_back(x);
+        coordinates.push_back(y);
+    }
+
+    double gridBuild = seconds([&]() { k::Grid grid(points.begin(), points.end()); });
+    double treeBuild = seconds([&]() { k::KdTree<int> tree(coordinates.data(), count, 2, 1); });
+    k::Grid grid(points.begin(), points.end());
+    k::KdTree<int> tree(coordinates.data(), count, 2, 1);
+    double gridQuery = seconds([&]() {
+        std::vector<k::Grid::Neighbor> neighbors;
+        for (auto query : queries) {
+            neighbors.clear();
+            grid.search(std::back_inserter(neighbors), query, k);
+        }
+    });
+    double treeQuery = seconds([&]() {
+        std::vector<k::KdTree<int>::Neighbor> neighbors;
+        for (auto [x, y] : queries) {
+            const int query[2] = {x, y};
+            neighbors.clear();
+            tree.search(std::back_inserter(neighbors), query, k);
+        }
+    });
+    std::cout << "grid : " << count << " uniform points, " << queryCount << " queries, K=" << k << std::endl;
+    std::cout << "  build  kd-tree " << treeBuild << " s, grid " << gridBuild << " s (" << treeBuild / gridBuild << "x)" << std::endl;
+    std::cout << "  query  kd-tree " << treeQuery << " s, grid " << gridQuery << " s (" << treeQuery / gridQuery << "x)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    const std::vector<std::pair<std::string, std::function<void()>>> benchmarks {
+        {"batch", benchBatch},
+        {"grid", benchGrid},
+    };
+    for (const auto& [name, bench] : benchmarks) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i) {
+            selected = selected || name == argv[i];
+        }
+        if (selected) {
+            bench();
+        }
+    }
+    return 0;
+}
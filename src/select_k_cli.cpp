@@ -0,0 +1,412 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  select_k : command line top-k / bottom-k over CSV / TSV lines
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ *  $ select_k -k 10 -f 3 --tsv scores.tsv          # 10 lines with the highest numeric value in column 3
+ *  $ cat scores.csv | select_k -k 5 -f 2 --bottom  # 5 lines with the lowest value in column 2
+ *
+ *  Replaces "sort -n | head" : O(N * Log(K)) time and O(K) memory, no temporary files.
+ *  Files are memory-mapped and selected lines are views into the mapping, stdin (and any other input that
+ *  is not a regular file, e.g. a FIFO or <(...)) is streamed and a line is only copied when it makes it
+ *  into the selection. Lines without a numeric score are skipped.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+#include "select_k/select_k.h"
+#include "select_k/select_k_mmap.h"
+#include "select_k/select_k_text.h"
+#include "select_k/select_k_io.h"
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <thread>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+enum class Io {
+    Mmap,
+    Pread,
+    Uring,
+};
+
+struct Options {
+    size_t k = 10;
+    size_t column = 0;
+    char delimiter = ',';
+    bool top = true;
+    bool header = false;
+    size_t threads = 0;
+    Io io = Io::Mmap;
+    std::vector<std::string> inputs;
+};
+
+struct Stats {
+    size_t lines = 0;
+    size_t skipped = 0;
+};
+
+void usage(const char* program) {
+    std::cerr << "usage: " << program << " [options] [file ...]" << std::endl
+              << "Prints the K lines with the best numeric score column (reads stdin if no file or '-' is given)" << std::endl
+              << "  -k, --count N        number of lines to select (default 10)" << std::endl
+              << "  -f, --field N        1-based score column (default 1)" << std::endl
+              << "  -d, --delimiter C    field delimiter (default ',', use '\\t' for tab)" << std::endl
+              << "      --csv            same as -d ','" << std::endl
+              << "      --tsv            same as -d '\\t'" << std::endl
+              << "  -t, --top            select the highest scores (default)" << std::endl
+              << "  -b, --bottom         select the lowest scores" << std::endl
+              << "  -H, --header         first line of each input is a header (printed once, not scored)" << std::endl
+              << "  -j, --threads N      threads used to scan each file (default: all cores, stdin is always 1)" << std::endl
+              << "      --io MODE        how files are read : mmap (default, parallel scan), uring (io_uring" << std::endl
+              << "                       read-ahead with O_DIRECT, pread if io_uring is unavailable) or pread" << std::endl
+              << "  -h, --help           this message" << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    enum { kCsv = 256, kTsv, kIo };
+    static const option longOptions[] = {
+        { "count", required_argument, nullptr, 'k' },
+        { "field", required_argument, nullptr, 'f' },
+        { "delimiter", required_argument, nullptr, 'd' },
+        { "csv", no_argument, nullptr, kCsv },
+        { "tsv", no_argument, nullptr, kTsv },
+        { "top", no_argument, nullptr, 't' },
+        { "bottom", no_argument, nullptr, 'b' },
+        { "header", no_argument, nullptr, 'H' },
+        { "threads", required_argument, nullptr, 'j' },
+        { "io", required_argument, nullptr, kIo },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 },
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "k:f:d:tbHj:h", longOptions, nullptr)) != -1) {
+        switch (c) {
+        case 'k':
+            if (!k::text::parseNumber(std::string_view(optarg), options.k)) {
+                std::cerr << "invalid count: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        case 'f':
+            if (!k::text::parseNumber(std::string_view(optarg), options.column) || options.column == 0) {
+                std::cerr << "invalid field: " << optarg << std::endl;
+                return false;
+            }
+            --options.column;
+            break;
+        case 'd': {
+            std::string_view delimiter(optarg);
+            if (delimiter == "\\t") {
+                options.delimiter = '\t';
+            } else if (delimiter.size() == 1) {
+                options.delimiter = delimiter[0];
+            } else {
+                std::cerr << "delimiter must be a single character: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        }
+        case kCsv: options.delimiter = ','; break;
+        case kTsv: options.delimiter = '\t'; break;
+        case kIo: {
+            std::string_view io(optarg);
+            if (io == "mmap") {
+                options.io = Io::Mmap;
+            } else if (io == "uring") {
+                options.io = Io::Uring;
+            } else if (io == "pread") {
+                options.io = Io::Pread;
+            } else {
+                std::cerr << "invalid io mode: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        }
+        case 't': options.top = true; break;
+        case 'b': options.top = false; break;
+        case 'H': options.header = true; break;
+        case 'j':
+            if (!k::text::parseNumber(std::string_view(optarg), options.threads)) {
+                std::cerr << "invalid thread count: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+    for (int i = optind; i < argc; ++i) {
+        options.inputs.push_back(argv[i]);
+    }
+    if (options.inputs.empty()) {
+        options.inputs.push_back("-");
+    }
+    return true;
+}
+
+/**
+ * Runs the selection over all inputs and prints the selected lines.
+ * Candidate is std::string_view (pointing into mapped files) or std::string (owned copy of a stdin line).
+ */
+template <typename Compare>
+class LineSelect {
+public:
+    using Selector = k::Select<std::string, double, Compare>;
+    using ViewSelector = k::Select<std::string_view, double, Compare>;
+
+    // smallest file chunk worth a scanning thread
+    static constexpr size_t kMinChunkBytes = 1 << 22;
+
+    explicit LineSelect(const Options& options)
+        : options_(options),
+          owned_(options.k, [this](const std::string& line) { return score(line); }),
+          views_(options.k, [this](const std::string_view& line) { return score(line); }) {}
+
+    int run() {
+        for (const auto& input : options_.inputs) {
+            if (input == "-") {
+                if (!scanStream(stdin, "stdin")) { return 1; }
+            } else if (options_.io != Io::Mmap) {
+                if (!scanBlocks(input)) { return 1; }
+            } else {
+                int streamed = scanIfNotRegular(input);
+                if (streamed < 0) { return 1; }
+                if (streamed > 0) { continue; }
+                try {
+                    files_.emplace_back(input);
+                } catch (const std::system_error& e) {
+                    std::cerr << "select_k: " << e.what() << std::endl;
+                    return 1;
+                }
+                const char* data = reinterpret_cast<const char*>(files_.back().data());
+                scanFile(data, data + files_.back().size());
+            }
+        }
+        if (stats_.skipped > 0) {
+            std::cerr << "select_k: skipped " << stats_.skipped << " of " << stats_.lines
+                      << " lines without a numeric value in field " << (options_.column + 1) << std::endl;
+        }
+        print();
+        return 0;
+    }
+
+private:
+    double score(std::string_view line) const {
+        double value = 0;
+        k::text::parseNumber(k::text::field(line, options_.delimiter, options_.column), value);
+        return value;
+    }
+
+    // consumes the header line (once per input), returns false if the line is to be scored
+    bool consumeHeader(std::string_view line) {
+        if (!options_.header || headerSeen_) { return false; }
+        headerSeen_ = true;
+        if (!headerPrinted_) {
+            header_ = line;
+            headerPrinted_ = true;
+        }
+        return true;
+    }
+
+    template <typename LineSelector>
+    const char* scan(const char* begin, const char* end, LineSelector& selector, Stats& stats, bool final = true) {
+        return k::text::forEachLine(begin, end, final, [&](std::string_view line) {
+            if (consumeHeader(line)) { return; }
+            ++stats.lines;
+            double value = 0;
+            if (!k::text::parseNumber(k::text::field(line, options_.delimiter, options_.column), value) || value != value) {
+                ++stats.skipped;
+                return;
+            }
+            if (selector.admits(value)) {
+                selector.offerScored(typename LineSelector::Candidate(line), value);
+            }
+        });
+    }
+
+    // a mapped file is split at line boundaries into one chunk per thread, per thread selections are merged
+    void scanFile(const char* begin, const char* end) {
+        if (options_.header && begin < end) {
+            const char* newline = k::text::findByte(begin, end, '\n');
+            k::text::forEachLine(begin, newline, true, [this](std::string_view line) { consumeHeader(line); });
+            begin = newline == end ? end : newline + 1;
+        }
+        headerSeen_ = true;
+        size_t threads = options_.threads;
+        if (threads == 0) {
+            threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        threads = std::max<size_t>(1, std::min(threads, static_cast<size_t>(end - begin) / kMinChunkBytes));
+        auto chunks = k::text::lineChunks(begin, end, threads);
+        if (chunks.size() <= 2) {
+            scan(begin, end, views_, stats_);
+        } else {
+            const size_t count = chunks.size() - 1;
+            std::vector<ViewSelector> selectors(count, ViewSelector(options_.k, [this](const std::string_view& line) { return score(line); }));
+            std::vector<Stats> stats(count);
+            std::vector<std::thread> workers;
+            workers.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                workers.emplace_back([&, i]() {
+                    scan(chunks[i], chunks[i + 1], selectors[i], stats[i]);
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            for (size_t i = 0; i < count; ++i) {
+                views_.merge(selectors[i]);
+                stats_.lines += stats[i].lines;
+                stats_.skipped += stats[i].skipped;
+            }
+        }
+        headerSeen_ = false;
+    }
+
+    bool scanStream(FILE* stream, const std::string& name) {
+        std::vector<char> buffer(1 << 20);
+        size_t read;
+        while ((read = std::fread(buffer.data(), 1, buffer.size(), stream)) > 0) {
+            feedBlock(buffer.data(), buffer.data() + read);
+        }
+        finishBlocks();
+        if (std::ferror(stream)) {
+            std::cerr << "select_k: error reading " << name << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // a pipe / FIFO / <(...) has no size to map : streams it instead, returns 1 if streamed, 0 if it is a regular file, -1 on error
+    int scanIfNotRegular(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "select_k: open " << path << ": " << std::generic_category().message(errno) << std::endl;
+            return -1;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            std::cerr << "select_k: fstat " << path << ": " << std::generic_category().message(errno) << std::endl;
+            ::close(fd);
+            return -1;
+        }
+        if (S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return 0;
+        }
+        FILE* stream = ::fdopen(fd, "rb");
+        if (stream == nullptr) {
+            ::close(fd);
+            std::cerr << "select_k: fdopen " << path << ": " << std::generic_category().message(errno) << std::endl;
+            return -1;
+        }
+        bool ok = scanStream(stream, path);
+        std::fclose(stream);
+        return ok ? 1 : -1;
+    }
+
+    // reads a file block by block (io_uring read-ahead or pread) instead of mapping it
+    bool scanBlocks(const std::string& path) {
+        try {
+            k::io::FileReader reader(path, 1 << 20, 8, options_.io == Io::Uring ? k::io::Backend::Uring : k::io::Backend::Pread);
+            reader.forEachBlock([this](const char* data, size_t size) {
+                feedBlock(data, data + size);
+            });
+        } catch (const std::system_error& e) {
+            std::cerr << "select_k: " << e.what() << std::endl;
+            return false;
+        }
+        finishBlocks();
+        return true;
+    }
+
+    // scans the complete lines of a transient block, a line split across blocks is carried over in pending_
+    void feedBlock(const char* begin, const char* end) {
+        if (!pending_.empty()) {
+            const char* newline = k::text::findByte(begin, end, '\n');
+            pending_.append(begin, newline);
+            if (newline == end) { return; }
+            scan(pending_.data(), pending_.data() + pending_.size(), owned_, stats_);
+            pending_.clear();
+            begin = newline + 1;
+        }
+        const char* tail = scan(begin, end, owned_, stats_, false);
+        pending_.assign(tail, end);
+    }
+
+    void finishBlocks() {
+        if (!pending_.empty()) {
+            scan(pending_.data(), pending_.data() + pending_.size(), owned_, stats_);
+            pending_.clear();
+        }
+        headerSeen_ = false;
+    }
+
+    void print() {
+        // selected file lines are views into the mappings, copy only those (at most K) into the owned selection
+        std::vector<std::pair<std::string_view, double>> selectedViews;
+        views_.scoredResults(std::back_inserter(selectedViews), false);
+        for (const auto& [line, value] : selectedViews) {
+            if (owned_.admits(value)) {
+                owned_.offerScored(std::string(line), value);
+            }
+        }
+        std::vector<std::string> lines;
+        owned_.results(std::back_inserter(lines), true, false);
+        if (headerPrinted_) {
+            std::fwrite(header_.data(), 1, header_.size(), stdout);
+            std::fputc('\n', stdout);
+        }
+        for (const auto& line : lines) {
+            std::fwrite(line.data(), 1, line.size(), stdout);
+            std::fputc('\n', stdout);
+        }
+    }
+
+    const Options& options_;
+    Selector owned_;
+    ViewSelector views_;
+    std::vector<k::MappedFile> files_;
+    Stats stats_;
+    std::string header_;
+    std::string pending_;
+    bool headerSeen_ = false;
+    bool headerPrinted_ = false;
+};
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (options.top) {
+        return LineSelect<std::greater<double>>(options).run();
+    }
+    return LineSelect<std::less<double>>(options).run();
+}
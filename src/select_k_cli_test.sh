@@ -0,0 +1,109 @@
+#!/bin/sh
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# ----------------------------------------------------------------------------------------------------------------
+#  select_k_cli_test : compares bin/select_k with "sort | head" over generated files (make cli-test)
+# ----------------------------------------------------------------------------------------------------------------
+#
+#  $ sh src/select_k_cli_test.sh [path to select_k]       # default bin/select_k
+#
+#  Scores are distinct so both sides agree on the order. Exits non zero if an output differs.
+# ---------------------------------------------------------------------------------------------------------------
+#
+set -u
+SELECT_K=${1:-bin/select_k}
+export LC_ALL=C
+DIR=$(mktemp -d /tmp/select_k_cli_XXXXXX)
+trap 'rm -rf "$DIR"' EXIT
+failures=0
+
+# compare NAME : the expected output is in $DIR/expected, the actual one in $DIR/actual
+compare() {
+    if cmp -s "$DIR/expected" "$DIR/actual"; then
+        echo "  ok  $1"
+    else
+        echo "  !!  $1"
+        diff "$DIR/expected" "$DIR/actual" | head -5
+        failures=$((failures + 1))
+    fi
+}
+
+# 5000 "id,score,payload" lines, score (i * 7919) % 10007 plus a decimal digit
+awk 'BEGIN { for (i = 0; i < 5000; i++) printf "row%d,%d.%d,p%d\n", i, (i * 7919) % 10007, i % 10, i }' > "$DIR/small.csv"
+
+sort -t, -k2,2gr "$DIR/small.csv" | head -n 10 > "$DIR/expected"
+"$SELECT_K" -k 10 -f 2 "$DIR/small.csv" > "$DIR/actual"
+compare "top 10 of a file"
+
+sort -t, -k2,2g "$DIR/small.csv" | head -n 7 > "$DIR/expected"
+"$SELECT_K" -k 7 -f 2 --bottom "$DIR/small.csv" > "$DIR/actual"
+compare "bottom 7 of a file"
+
+sort -t, -k2,2gr "$DIR/small.csv" | head -n 10 > "$DIR/expected"
+"$SELECT_K" -k 10 -f 2 < "$DIR/small.csv" > "$DIR/actual"
+compare "top 10 of stdin"
+# inputs that are not regular files (no size to map) are streamed
+mkfifo "$DIR/fifo"
+cat "$DIR/small.csv" > "$DIR/fifo" &
+"$SELECT_K" -k 10 -f 2 "$DIR/fifo" > "$DIR/actual"
+wait
+compare "top 10 of a FIFO"
+if [ -e /dev/fd/0 ]; then
+    cat "$DIR/small.csv" | "$SELECT_K" -k 10 -f 2 /dev/fd/0 > "$DIR/actual"
+    compare "top 10 of a pipe named by /dev/fd"
+fi
+for io in pread uring; do
+    "$SELECT_K" -k 10 -f 2 --io $io "$DIR/small.csv" > "$DIR/actual"
+    compare "top 10 with --io $io"
+    cat "$DIR/small.csv" > "$DIR/fifo" &
+    "$SELECT_K" -k 10 -f 2 --io $io "$DIR/fifo" > "$DIR/actual"
+    wait
+    compare "top 10 of a FIFO with --io $io"
+done
+
+# a header line is printed once and never scored, from a file and from stdin
+{ echo "id,score,payload"; cat "$DIR/small.csv"; } > "$DIR/header.csv"
+{ echo "id,score,payload"; sort -t, -k2,2gr "$DIR/small.csv" | head -n 5; } > "$DIR/expected"
+"$SELECT_K" -k 5 -f 2 -H "$DIR/header.csv" > "$DIR/actual"
+compare "header file"
+"$SELECT_K" -k 5 -f 2 -H < "$DIR/header.csv" > "$DIR/actual"
+compare "header stdin"
+
+# the best line is the last one and has no trailing newline
+{ cat "$DIR/small.csv"; printf "last,20000,x"; } > "$DIR/unterminated.csv"
+{ echo "last,20000,x"; sort -t, -k2,2gr "$DIR/small.csv" | head -n 2; } > "$DIR/expected"
+"$SELECT_K" -k 3 -f 2 "$DIR/unterminated.csv" > "$DIR/actual"
+compare "no trailing newline, file"
+"$SELECT_K" -k 3 -f 2 < "$DIR/unterminated.csv" > "$DIR/actual"
+compare "no trailing newline, stdin"
+"$SELECT_K" -k 3 -f 2 --io pread "$DIR/unterminated.csv" > "$DIR/actual"
+compare "no trailing newline, --io pread"
+
+# ~20 MB so -j 4 splits it into several chunks (each at least 4 MB), lines straddle the chunk cuts
+awk 'BEGIN { for (i = 0; i < 400000; i++) printf "row%d,%d.%d,payload-%040d\n", i, (i * 7919) % 1000003, i % 10, i }' > "$DIR/large.csv"
+sort -t, -k2,2gr "$DIR/large.csv" | head -n 25 > "$DIR/expected"
+for threads in 1 4; do
+    "$SELECT_K" -k 25 -f 2 -j $threads "$DIR/large.csv" > "$DIR/actual"
+    compare "top 25 of a large file, -j $threads"
+done
+sort -t, -k2,2g "$DIR/large.csv" | head -n 25 > "$DIR/expected"
+"$SELECT_K" -k 25 -f 2 -j 4 --bottom "$DIR/large.csv" > "$DIR/actual"
+compare "bottom 25 of a large file, -j 4"
+
+if [ $failures -eq 0 ]; then
+    echo "all select_k checks passed"
+else
+    echo "$failures select_k checks failed"
+fi
+[ $failures -eq 0 ]
@@ -43,7 +43,109 @@
  * 
  */
 #include "select_k/select_k.h"
+#include "select_k/select_k_mmap.h"
+#include "select_k/select_k_process.h"
+#include "select_k/select_k_columnar.h"
+#include "select_k/select_k_vector.h"
+#include "select_k/select_k_kdtree.h"
+#include "select_k/select_k_vptree.h"
+#include "select_k/select_k_grid.h"
+#include "select_k/select_k_pq.h"
+#include "select_k/select_k_hnsw.h"
+#include "select_k/select_k_ivf.h"
+#include "select_k/select_k_quantized.h"
+#include "select_k/select_k_hamming.h"
+#include "select_k/select_k_dataset.h"
+#include "select_k/select_k_join.h"
+#include "select_k/select_k_nndescent.h"
+#include "select_k/select_k_external.h"
 #include <iostream>
+#include <fstream>
+#include <bit>
+#include <random>
+#include <set>
+#include <numeric>
+
+// checks that failed (main returns non zero if any did)
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        ++failures;
+        std::cout << "  !! " << what << " failed!" << std::endl;
+    }
+}
+
+// count rows of dim floats scattered around 32 random centres (fixed seed, every run sees the same data)
+std::vector<float> clusteredRows(size_t count, size_t dim, unsigned seed) {
+    std::mt19937 random(seed);
+    std::normal_distribution<float> normal;
+    std::vector<float> centres(32 * dim);
+    for (auto& value : centres) {
+        value = 4 * normal(random);
+    }
+    std::vector<float> rows(count * dim);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t centre = random() % 32;
+        for (size_t d = 0; d < dim; ++d) {
+            rows[i * dim + d] = centres[centre * dim + d] + normal(random);
+        }
+    }
+    return rows;
+}
+
+// count base rows and queryCount held out query rows drawn around the same centres
+std::pair<std::vector<float>, std::vector<float>> clusteredSplit(size_t count, size_t queryCount, size_t dim, unsigned seed) {
+    std::vector<float> rows = clusteredRows(count + queryCount, dim, seed);
+    std::vector<float> queries(rows.begin() + count * dim, rows.end());
+    rows.resize(count * dim);
+    return {std::move(rows), std::move(queries)};
+}
+
+// mean fraction of the exact K nearest (k::Nearest, among the rows filter allows) that search(neighbors, query)
+// finds, over the rows of queries
+template <typename Search>
+double recall(const k::Nearest& exact, const std::vector<float>& queries, size_t k, Search search, const k::Filter& filter = {}) {
+    const size_t dim = exact.dim();
+    size_t found = 0;
+    for (size_t q = 0; q < queries.size() / dim; ++q) {
+        std::vector<k::Nearest::Neighbor> truth, neighbors;
+        exact.search(std::back_inserter(truth), queries.data() + q * dim, k, filter);
+        search(neighbors, queries.data() + q * dim);
+        std::set<size_t> rows;
+        for (auto [index, distance] : truth) {
+            rows.insert(index);
+        }
+        for (auto [index, distance] : neighbors) {
+            found += rows.count(index);
+        }
+    }
+    return double(found) / double(queries.size() / dim * k);
+}
+
+// neighbors (index, score) must be the K best of scores (the brute force score of every index), ties in any order :
+// the same sorted scores (within tolerance, relative) and each one the score of its own, distinct, index
+template <typename Neighbor, typename Score>
+bool bruteForce(const std::vector<Neighbor>& neighbors, const std::vector<Score>& scores, size_t k, bool smallerIsNearer,
+                double tolerance = 0) {
+    std::vector<Score> sorted(scores);
+    if (smallerIsNearer) {
+        std::sort(sorted.begin(), sorted.end());
+    } else {
+        std::sort(sorted.begin(), sorted.end(), std::greater<Score>());
+    }
+    sorted.resize(std::min(k, sorted.size()));
+    if (neighbors.size() != sorted.size()) { return false; }
+    auto close = [tolerance](double a, double b) { return std::abs(a - b) <= tolerance * (1 + std::abs(b)); };
+    std::set<size_t> seen;
+    for (size_t i = 0; i < neighbors.size(); ++i) {
+        const auto [index, score] = neighbors[i];
+        if (index >= scores.size() || !seen.insert(index).second || !close(score, sorted[i]) || !close(score, scores[index])) {
+            return false;
+        }
+    }
+    return true;
+}
 
 void testInts() {
     std::vector<int> inputs {
@@ -116,6 +218,852 @@ void testPoints() {
     for (auto p : results) {
         std::cout << " => " << p.first <<","<<p.second << std::endl;
     }
+
+    std::cout << "Trying kd-tree search ..." << std::endl;
+    std::vector<int> coordinates;
+    for (auto p : inputs) {
+        coordinates.push_back(p.first);
+        coordinates.push_back(p.second);
+    }
+    k::KdTree<int> tree(coordinates.data(), inputs.size(), 2);
+    const int origin[2] = {0, 0};
+    std::vector<k::KdTree<int>::Neighbor> neighbors;
+    tree.search(std::back_inserter(neighbors), origin, 4);
+    for (auto [index, distance] : neighbors) {
+        std::cout << " => " << inputs[index].first << "," << inputs[index].second << std::endl;
+    }
+    // K = 20 is past the 9 points, a query off to the side sees ties
+    for (const auto& [query, k] : {std::pair{Point{0, 0}, size_t(4)}, {Point{0, 0}, size_t(20)}, {Point{7, -2}, size_t(5)}}) {
+        const int at[2] = {query.first, query.second};
+        std::vector<int64_t> distances;
+        for (auto [x, y] : inputs) {
+            distances.push_back(int64_t(x - query.first) * (x - query.first) + int64_t(y - query.second) * (y - query.second));
+        }
+        neighbors.clear();
+        tree.search(std::back_inserter(neighbors), at, k);
+        check(bruteForce(neighbors, distances, k, true), "kd-tree points K=" + std::to_string(k));
+    }
+
+    std::cout << "Trying grid search ..." << std::endl;
+    k::Grid grid(inputs.begin(), inputs.end());
+    std::vector<k::Grid::Neighbor> cells;
+    grid.search(std::back_inserter(cells), {0, 0}, 4);
+    for (auto [index, distance] : cells) {
+        std::cout << " => " << inputs[index].first << "," << inputs[index].second << std::endl;
+    }
+
+    // two clusters with an empty band between them, and a few duplicates : queries inside the clusters, in the
+    // empty band, and far outside the bounding box, with K up to past the point count
+    std::mt19937 random(14);
+    std::vector<Point> scattered;
+    for (int i = 0; i < 3000; ++i) {
+        const int x = static_cast<int>(random() % 1000), y = static_cast<int>(random() % 1000);
+        scattered.emplace_back(i % 2 == 0 ? x : x + 5000, y);
+    }
+    scattered.insert(scattered.end(), scattered.begin(), scattered.begin() + 20);
+    const std::vector<Point> queries { {500, 500}, {5500, 10}, {3000, 500}, {3000, -4000}, {-100000, 100000}, {6000, 999} };
+    for (int64_t cellSize : {int64_t(0), int64_t(7), int64_t(400)}) {
+        k::Grid big(scattered.begin(), scattered.end(), cellSize);
+        bool same = true;
+        for (auto query : queries) {
+            std::vector<int64_t> distances;
+            for (auto [x, y] : scattered) {
+                distances.push_back(int64_t(x - query.first) * (x - query.first) + int64_t(y - query.second) * (y - query.second));
+            }
+            for (size_t k : {size_t(1), size_t(10), size_t(100), scattered.size() + 10}) {
+                cells.clear();
+                big.search(std::back_inserter(cells), query, k);
+                same = same && bruteForce(cells, distances, k, true);
+            }
+        }
+        check(same, "grid brute force with cell size " + std::to_string(big.cellSize()));
+    }
+}
+// a selector filled with 5000 pseudo random ints must come back from serialize() / deserialize() with the same
+// results, and keep selecting the same way afterwards
+template <typename Selector>
+void checkRoundTrip(const std::string& name) {
+    auto identity = [](const int& v){ return v; };
+    Selector selector(50, identity);
+    for (int i = 0; i < 5000; ++i) {
+        selector.offer((i * 7919) % 10007);
+    }
+    k::BufferCodec codec;
+    selector.serialize(codec);
+    Selector restored(0, identity);
+    bool same = restored.deserialize(codec) && restored.k() == selector.k();
+    for (int i = 0; i < 1000; ++i) {
+        selector.offer((i * 104729) % 20011);
+        restored.offer((i * 104729) % 20011);
+    }
+    std::vector<int> before, after;
+    selector.results(std::back_inserter(before), true, false);
+    restored.results(std::back_inserter(after), true, false);
+    check(same && before.size() == 50 && before == after, "checkpoint round trip " + name);
+}
+void testCheckpoint() {
+    auto identity = [](const int& v){ return v; };
+    k::Top<int, int> selector(3, identity);
+    for (auto v : {5, 1, 42, 7, 13}) {
+        selector.offer(v);
+    }
+    k::BufferCodec codec;
+    selector.serialize(codec);
+    std::cout << "checkpointed k=" << selector.k() << " (" << codec.bytes().size() << " bytes)" << std::endl;
+
+    k::Top<int, int> restored(0, identity);
+    if (!restored.deserialize(codec)) {
+        std::cout << "restore failed!" << std::endl;
+        return;
+    }
+    for (auto v : {8, 99}) {
+        restored.offer(v);
+    }
+    std::vector<int> results;
+    restored.results(std::back_inserter(results), true, false);
+    std::cout << "Top after restore =>" << std::endl;
+    for (auto v : results) {
+        std::cout << "  => " << v << std::endl;
+    }
+    check(results == std::vector<int>({99, 42, 13}), "checkpoint restore + offer");
+
+    checkRoundTrip<k::Top<int, int>>("top");
+    checkRoundTrip<k::Bottom<int, int>>("bottom");
+
+    // streams deserialize must refuse : truncated, bad magic, a stored count far past the bytes that follow
+    const std::vector<uint8_t> good = codec.bytes();
+    std::vector<uint8_t> truncated(good.begin(), good.end() - 1), badMagic = good, oversized = good;
+    badMagic[0] ^= 0xff;
+    const uint64_t huge = uint64_t(1) << 40;
+    std::memcpy(oversized.data() + 2 * sizeof(uint32_t), &huge, sizeof(huge));
+    std::memcpy(oversized.data() + 2 * sizeof(uint32_t) + sizeof(uint64_t), &huge, sizeof(huge));
+    for (const auto& [name, bytes] : {std::pair{"truncated", truncated}, {"bad magic", badMagic}, {"oversized count", oversized}}) {
+        k::BufferCodec corrupt(bytes);
+        k::Top<int, int> target(0, identity);
+        check(!target.deserialize(corrupt), std::string("checkpoint rejects ") + name);
+    }
+    k::BufferCodec intact(good);
+    check(k::Top<int, int>(0, identity).deserialize(intact), "checkpoint accepts the intact stream");
+    // a k::Top keeps its worst entry on top, which is not heap order for a k::Bottom
+    k::BufferCodec mismatched(good);
+    check(!k::Bottom<int, int>(0, identity).deserialize(mismatched), "checkpoint rejects a k::Top stream in a k::Bottom");
+}
+void testRecords() {
+    struct Feature {
+        uint32_t id;
+        float score;
+    };
+    char path[] = "/tmp/select_k_records_XXXXXX";
+    int fd = ::mkstemp(path);
+    if (fd < 0) {
+        std::cout << "could not create temp file!" << std::endl;
+        return;
+    }
+    ::close(fd);
+    // enough records for 4 threads of kMinRecordsPerThread, distinct scores so the order is unique
+    const uint32_t count = 300000;
+    std::vector<float> scores(count);
+    {
+        std::ofstream file(path, std::ios::binary);
+        for (uint32_t i = 0; i < count; ++i) {
+            scores[i] = static_cast<float>((uint64_t(i) * 7919) % 300007);
+            Feature feature { i, scores[i] };
+            file.write(reinterpret_cast<const char*>(&feature), sizeof(feature));
+        }
+    }
+    k::MappedFile file(path);
+    k::Records records(file, sizeof(Feature));
+    std::vector<size_t> best;
+    k::TopRecords<float>::compute(std::back_inserter(best), 3, records, offsetof(Feature, score));
+    std::cout << "top 3 of " << records.count() << " records =>" << std::endl;
+    for (auto index : best) {
+        auto record = records.record(index);
+        std::cout << "  => id " << record.field<uint32_t>(offsetof(Feature, id)) << " score " << record.field<float>(offsetof(Feature, score)) << std::endl;
+    }
+
+    std::vector<size_t> expected(count);
+    std::iota(expected.begin(), expected.end(), 0);
+    std::partial_sort(expected.begin(), expected.begin() + 100, expected.end(), [&](size_t a, size_t b) { return scores[a] > scores[b]; });
+    expected.resize(100);
+    for (size_t threads : {1, 4}) {
+        best.clear();
+        k::TopRecords<float>::compute(std::back_inserter(best), 100, records, offsetof(Feature, score), threads);
+        check(best == expected, "records top 100 with " + std::to_string(threads) + " threads");
+    }
+    // the score field must fit inside the record
+    for (size_t offset : {size_t(5), sizeof(Feature), size_t(-1)}) {
+        bool threw = false;
+        try {
+            k::TopRecords<float>::compute(std::back_inserter(best), 3, records, offset);
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        check(threw, "records score offset " + std::to_string(offset) + " rejected");
+    }
+    ::unlink(path);
+}
+void testForkMerge() {
+    // 4 worker processes, worker i scores the integers in [i * 1000, (i + 1) * 1000)
+    using Selector = k::Bottom<int, int>;
+    auto distanceTo1234 = [](const int& v){ return (v - 1234) * (v - 1234); };
+    Selector selector(3, distanceTo1234);
+    bool ok = k::forkMerge(selector, 4, [](size_t shard, Selector& partial) {
+        for (int v = static_cast<int>(shard) * 1000; v < static_cast<int>(shard + 1) * 1000; ++v) {
+            partial.offer(v);
+        }
+    });
+    std::vector<int> results;
+    selector.results(std::back_inserter(results), true, false);
+    std::cout << "closest to 1234 " << (ok ? "(all workers ok)" : "(worker failed!)") << " =>" << std::endl;
+    for (auto v : results) {
+        std::cout << "  => " << v << std::endl;
+    }
+    // 1233 and 1235 tie
+    check(ok && results.size() == 3 && results[0] == 1234 && std::set<int>(results.begin(), results.end()) == std::set<int>({1233, 1234, 1235}),
+          "fork / merge closest to 1234");
+
+    // worker i scores items[j] for j % workers == i, the merge must equal one k::Top over all of them;
+    // with 16 workers and 10 items some workers send back an empty selection
+    for (size_t itemCount : {size_t(10), size_t(5000)}) {
+        std::vector<int> items(itemCount);
+        for (size_t j = 0; j < itemCount; ++j) {
+            items[j] = static_cast<int>((j * 7919) % 10007);
+        }
+        auto identity = [](const int& v){ return v; };
+        for (size_t workers : {size_t(3), size_t(16)}) {
+            k::Top<int, int> merged(25, identity);
+            bool workersOk = k::forkMerge(merged, workers, [&](size_t shard, k::Top<int, int>& partial) {
+                for (size_t j = shard; j < items.size(); j += workers) {
+                    partial.offer(items[j]);
+                }
+            });
+            std::vector<int> forked, single;
+            merged.results(std::back_inserter(forked), true, false);
+            k::Top<int, int>::compute(std::back_inserter(single), 25, items.begin(), items.end(), identity);
+            check(workersOk && forked == single, "fork / merge of " + std::to_string(itemCount) + " items over " +
+                  std::to_string(workers) + " workers");
+        }
+    }
+}
+void testColumnar() {
+    // 1000 distinct scores : rows 64..127 (a whole block) are null, every 5th row is null, the last block is partial
+    const size_t count = 1000;
+    std::vector<double> scores(count);
+    std::vector<uint64_t> validity((count + 63) / 64, 0);
+    std::vector<std::string> rowIds;
+    for (size_t row = 0; row < count; ++row) {
+        scores[row] = static_cast<double>((row * 7919) % count) - 500.0;
+        rowIds.push_back("row" + std::to_string(row));
+        if (row % 5 != 0 && (row < 64 || row >= 128)) {
+            validity[row / 64] |= uint64_t(1) << (row % 64);
+        }
+    }
+    // the non null rows (of the first valid ones), best first
+    auto expected = [&](bool top, size_t k, size_t valid) {
+        std::vector<size_t> rows;
+        for (size_t row = 0; row < count; ++row) {
+            if (row < valid && (validity.empty() || (validity[row / 64] >> (row % 64) & 1))) {
+                rows.push_back(row);
+            }
+        }
+        std::sort(rows.begin(), rows.end(), [&](size_t a, size_t b) { return top ? scores[a] > scores[b] : scores[a] < scores[b]; });
+        rows.resize(std::min(k, rows.size()));
+        return rows;
+    };
+    std::span<const double> column(scores);
+    for (size_t k : {size_t(1), size_t(10), size_t(64), size_t(2000)}) {
+        std::vector<size_t> top, bottom;
+        k::TopColumn<double>::compute(std::back_inserter(top), k, column, validity);
+        k::BottomColumn<double>::compute(std::back_inserter(bottom), k, column, validity);
+        check(top == expected(true, k, count) && bottom == expected(false, k, count), "columnar top / bottom K=" + std::to_string(k));
+
+        // a bitmap covering only the first 5 blocks : the rest of the column is null
+        std::span<const uint64_t> shortValidity(validity.data(), 5);
+        top.clear();
+        k::TopColumn<double>::compute(std::back_inserter(top), k, column, shortValidity);
+        check(top == expected(true, k, 5 * 64), "columnar short bitmap K=" + std::to_string(k));
+
+        // row ids instead of positions
+        std::vector<std::string> ids, wanted;
+        k::BottomColumn<double>::compute(std::back_inserter(ids), k, column, std::span<const std::string>(rowIds), validity);
+        for (size_t row : expected(false, k, count)) {
+            wanted.push_back(rowIds[row]);
+        }
+        check(ids == wanted, "columnar row ids K=" + std::to_string(k));
+    }
+    // no bitmap : every row is valid
+    validity.clear();
+    std::vector<size_t> top;
+    k::TopColumn<double>::compute(std::back_inserter(top), 10, column);
+    check(top == expected(true, 10, count), "columnar without bitmap");
+    std::cout << "top 3 of " << count << " scores => rows " << top[0] << ", " << top[1] << ", " << top[2] << std::endl;
+}
+void testNearest() {
+    // 5 vectors of dimension 4, row major
+    const size_t dim = 4;
+    std::vector<float> base {
+        0, 0, 0, 0,
+        1, 1, 1, 1,
+        2, 2, 2, 2,
+        0, 1, 0, 1,
+        5, 5, 5, 5,
+    };
+    std::vector<float> query { 1, 1, 1, 0 };
+    k::Nearest nearest(base.data(), base.size() / dim, dim);
+    std::vector<k::Nearest::Neighbor> neighbors;
+    nearest.search(std::back_inserter(neighbors), query.data(), 3);
+    std::cout << "3 nearest to (1,1,1,0) =>" << std::endl;
+    for (auto [index, distance] : neighbors) {
+        std::cout << "  => row " << index << " squared distance " << distance << std::endl;
+    }
+    k::Nearest similar(base.data(), base.size() / dim, dim, k::Metric::Cosine);
+    neighbors.clear();
+    similar.search(std::back_inserter(neighbors), query.data(), 3);
+    std::cout << "3 most cosine similar to (1,1,1,0) =>" << std::endl;
+    for (auto [index, similarity] : neighbors) {
+        std::cout << "  => row " << index << " cosine similarity " << similarity << std::endl;
+    }
+
+    // every metric against a scalar scan, dim 37 leaves a tail after the SIMD lanes, K = 1500 is past the row count;
+    // 40 queries make searchBatch run a full and a partial tile of kQueryTile, it must return what search() does
+    const size_t count = 1000, dimension = 37, queryCount = 40;
+    auto [rows, queries] = clusteredSplit(count, queryCount, dimension, 12);
+    for (k::Metric metric : {k::Metric::L2, k::Metric::InnerProduct, k::Metric::Cosine}) {
+        k::Nearest index(rows.data(), count, dimension, metric);
+        bool same = true, batchSame = true;
+        for (size_t k : {size_t(1), size_t(10), size_t(1500)}) {
+            auto batch = index.searchBatch(queries.data(), queryCount, k, 1);
+            auto threaded = index.searchBatch(queries.data(), queryCount, k, 3);
+            for (size_t q = 0; q < queryCount; ++q) {
+                const float* query = queries.data() + q * dimension;
+                std::vector<double> scores(count);
+                for (size_t row = 0; row < count; ++row) {
+                    double dot = 0, l2 = 0, rowNorm = 0, queryNorm = 0;
+                    for (size_t d = 0; d < dimension; ++d) {
+                        const double a = query[d], b = rows[row * dimension + d];
+                        dot += a * b;
+                        l2 += (a - b) * (a - b);
+                        rowNorm += b * b;
+                        queryNorm += a * a;
+                    }
+                    scores[row] = metric == k::Metric::L2 ? l2 : (metric == k::Metric::InnerProduct ? dot : dot / std::sqrt(rowNorm * queryNorm));
+                }
+                neighbors.clear();
+                index.search(std::back_inserter(neighbors), query, k);
+                same = same && bruteForce(neighbors, scores, k, metric == k::Metric::L2, 1e-4);
+                // the same rows as search() (tied rows may come in another order)
+                std::set<size_t> searched, batched;
+                for (auto [index, score] : neighbors) {
+                    searched.insert(index);
+                }
+                for (auto [index, score] : batch[q]) {
+                    batched.insert(index);
+                }
+                batchSame = batchSame && bruteForce(batch[q], scores, k, metric == k::Metric::L2, 1e-4) && searched == batched &&
+                            threaded[q] == batch[q];
+            }
+        }
+        check(same, "nearest brute force metric " + std::to_string(static_cast<int>(metric)));
+        check(batchSame, "nearest batch equals search metric " + std::to_string(static_cast<int>(metric)));
+    }
+}
+void testVpTree() {
+    auto editDistance = [](const std::string& a, const std::string& b) {
+        std::vector<int> previous(b.size() + 1), current(b.size() + 1);
+        for (size_t j = 0; j <= b.size(); ++j) {
+            previous[j] = static_cast<int>(j);
+        }
+        for (size_t i = 1; i <= a.size(); ++i) {
+            current[0] = static_cast<int>(i);
+            for (size_t j = 1; j <= b.size(); ++j) {
+                current[j] = std::min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + (a[i - 1] != b[j - 1] ? 1 : 0)});
+            }
+            std::swap(previous, current);
+        }
+        return previous[b.size()];
+    };
+    std::vector<std::string> words { "kitten", "sitting", "mitten", "bitten", "kitchen", "written", "smitten", "knitting", "fitting", "sitter" };
+    k::VpTree<std::string, int> tree(words.begin(), words.end(), editDistance);
+    std::vector<std::string> queries { "sitten", "kitted" };
+    auto results = tree.searchBatch(queries.begin(), queries.end(), 3);
+    for (size_t q = 0; q < queries.size(); ++q) {
+        std::cout << "3 closest to " << queries[q] << " =>" << std::endl;
+        for (auto [index, distance] : results[q]) {
+            std::cout << "  => " << words[index] << " edit distance " << distance << std::endl;
+        }
+    }
+
+    // 500 generated words against brute force edit distances (many ties), K = 600 is past the word count
+    std::mt19937 random(13);
+    std::vector<std::string> generated(500);
+    for (auto& word : generated) {
+        word.resize(3 + random() % 6);
+        for (auto& c : word) {
+            c = static_cast<char>('a' + random() % 4);
+        }
+    }
+    k::VpTree<std::string, int> big(generated.begin(), generated.end(), editDistance);
+    std::vector<std::string> probes { "abcd", "aaaaaaaaaa", "d", "zzz", generated[17] };
+    bool same = true;
+    for (size_t k : {size_t(1), size_t(5), size_t(40), size_t(600)}) {
+        auto batch = big.searchBatch(probes.begin(), probes.end(), k);
+        for (size_t q = 0; q < probes.size(); ++q) {
+            std::vector<int> distances;
+            for (const auto& word : generated) {
+                distances.push_back(editDistance(probes[q], word));
+            }
+            std::vector<k::VpTree<std::string, int>::Neighbor> single;
+            big.search(std::back_inserter(single), probes[q], k);
+            same = same && bruteForce(single, distances, k, true) && bruteForce(batch[q], distances, k, true);
+        }
+    }
+    check(same, "vp-tree brute force");
+
+    // the selector returned for a temporary query still scores later offers against it
+    auto selector = tree.select(std::string(64, 'x') + "kitten", 1);
+    for (size_t position = 0; position < tree.count(); ++position) {
+        selector.offer(position);
+    }
+    std::vector<size_t> positions;
+    selector.results(std::back_inserter(positions), true, false);
+    check(positions.size() == 1 && words[tree.node(positions[0]).id] == "kitten", "vp-tree select keeps its query");
+}
+void testPq() {
+    const size_t count = 4000, dim = 32, k = 10;
+    std::vector<float> base = clusteredRows(count, dim, 1);
+    std::vector<float> queries = clusteredRows(50, dim, 2);
+    k::Nearest exact(base.data(), count, dim);
+    for (size_t bits : {8, 4}) {
+        for (size_t subspaces : {8, 16, 32}) {
+            k::PqOptions options;
+            options.bits = bits;
+            options.subspaces = subspaces;
+            k::Pq index(base.data(), count, dim, options);
+            index.build();
+            double found = recall(exact, queries, k, [&index](std::vector<k::Pq::Neighbor>& neighbors, const float* query) {
+                index.search(std::back_inserter(neighbors), query, 10, 100);
+            });
+            std::cout << "pq " << bits << " bit M=" << subspaces << " recall@10 (R=100) " << found << std::endl;
+            // 4 bit codes are coarse at small M, but 32 subspaces of 1 dim each must find (almost) everything
+            const double minimum = bits == 8 ? 0.9 : (subspaces == 8 ? 0.4 : (subspaces == 16 ? 0.7 : 0.95));
+            check(found >= minimum, "pq recall");
+        }
+    }
+}
+void testHnsw() {
+    const size_t count = 4000, dim = 32, k = 10;
+    auto [base, queries] = clusteredSplit(count, 50, dim, 3);
+    for (k::Metric metric : {k::Metric::L2, k::Metric::Cosine}) {
+        k::Nearest exact(base.data(), count, dim, metric);
+        k::Hnsw index(base.data(), count, dim, metric);
+        index.build();
+        double found = recall(exact, queries, k, [&index](std::vector<k::Nearest::Neighbor>& neighbors, const float* query) {
+            index.search(std::back_inserter(neighbors), query, 10);
+        });
+        std::cout << "hnsw " << (metric == k::Metric::L2 ? "l2" : "cosine") << " recall@10 " << found << std::endl;
+        check(found >= 0.9, "hnsw recall");
+
+        // a saved graph answers like the one it was saved from
+        k::BufferCodec codec;
+        index.serialize(codec);
+        k::Hnsw loaded(base.data(), count, dim, metric);
+        check(loaded.deserialize(codec), "hnsw load");
+        std::vector<k::Nearest::Neighbor> before, after;
+        index.search(std::back_inserter(before), queries.data(), k);
+        loaded.search(std::back_inserter(after), queries.data(), k);
+        check(before == after, "hnsw reload");
+
+        // a corrupt graph (M far past kMaxM, then a cut off stream) is rejected and leaves the index as it was
+        std::vector<uint8_t> bytes = codec.bytes();
+        const uint64_t hugeM = uint64_t(1) << 40;
+        std::memcpy(bytes.data() + 4 * sizeof(uint32_t) + 2 * sizeof(uint64_t), &hugeM, sizeof(hugeM));
+        k::BufferCodec corrupt(bytes);
+        k::BufferCodec truncated(std::vector<uint8_t>(codec.bytes().begin(), codec.bytes().end() - 4));
+        check(!loaded.deserialize(corrupt) && !loaded.deserialize(truncated), "hnsw corrupt load");
+        after.clear();
+        loaded.search(std::back_inserter(after), queries.data(), k);
+        check(before == after, "hnsw failed load keeps the index");
+
+        // efConstruction 0 (from the options or a saved header) is raised to M, an empty beam has nothing to link
+        k::HnswOptions narrow;
+        narrow.efConstruction = 0;
+        k::Hnsw small(base.data(), 500, dim, metric, narrow);
+        small.build();
+        std::vector<k::Nearest::Neighbor> neighbors;
+        small.search(std::back_inserter(neighbors), base.data(), k);
+        check(small.options().efConstruction >= small.options().M && !neighbors.empty() && neighbors[0].first == 0,
+              "hnsw efConstruction 0");
+        bytes = codec.bytes();
+        const uint64_t zero = 0;
+        std::memcpy(bytes.data() + 4 * sizeof(uint32_t) + 3 * sizeof(uint64_t), &zero, sizeof(zero));
+        k::BufferCodec zeroEf(bytes);
+        check(loaded.deserialize(zeroEf) && loaded.options().efConstruction >= loaded.options().M, "hnsw load efConstruction 0");
+    }
+}
+void testIvf() {
+    const size_t count = 4000, dim = 32, k = 10, queryCount = 50;
+    auto [base, queries] = clusteredSplit(count, queryCount, dim, 4);
+    k::Nearest exact(base.data(), count, dim);
+    k::IvfOptions options;
+    options.lists = 64;
+    k::Ivf index(base.data(), count, dim, k::Metric::L2, options);
+    index.build();
+    for (size_t nprobe : {1, 4, 64}) {
+        double found = recall(exact, queries, k, [&](std::vector<k::Ivf::Neighbor>& neighbors, const float* query) {
+            index.search(std::back_inserter(neighbors), query, k, nprobe);
+        });
+        std::cout << "ivf nprobe=" << nprobe << " recall@10 " << found << std::endl;
+        // probing every list is an exact scan
+        check(found >= (nprobe == options.lists ? 1.0 : (nprobe == 1 ? 0.6 : 0.9)), "ivf recall");
+    }
+    auto results = index.searchBatch(queries.data(), queryCount, k, 16);
+    bool same = true;
+    for (size_t q = 0; q < queryCount; ++q) {
+        std::vector<k::Ivf::Neighbor> neighbors;
+        index.search(std::back_inserter(neighbors), queries.data() + q * dim, k, 16);
+        for (size_t i = 0; i < neighbors.size(); ++i) {
+            same = same && i < results[q].size() && results[q][i].first == neighbors[i].first;
+        }
+    }
+    check(same, "ivf batch");
+
+    // Cosine lists hold the normalized rows, permuted into list order in place : probing every list is exact too
+    k::Nearest exactCosine(base.data(), count, dim, k::Metric::Cosine);
+    k::Ivf cosine(base.data(), count, dim, k::Metric::Cosine, options);
+    cosine.build();
+    double found = recall(exactCosine, queries, k, [&](std::vector<k::Ivf::Neighbor>& neighbors, const float* query) {
+        cosine.search(std::back_inserter(neighbors), query, k, options.lists);
+    });
+    std::cout << "ivf cosine nprobe=" << options.lists << " recall@10 " << found << std::endl;
+    check(found >= 1.0, "ivf cosine recall");
+}
+void testQuantized() {
+    const size_t count = 4000, dim = 32, k = 10;
+    auto [base, queries] = clusteredSplit(count, 50, dim, 5);
+    k::Nearest exact(base.data(), count, dim);
+    for (k::Storage storage : {k::Storage::Int8, k::Storage::Half}) {
+        k::QuantizedNearest index(base.data(), count, dim, storage);
+        for (size_t rerank : {k, 4 * k}) {
+            double found = recall(exact, queries, k, [&](std::vector<k::QuantizedNearest::Neighbor>& neighbors, const float* query) {
+                index.search(std::back_inserter(neighbors), query, k, rerank);
+            });
+            std::cout << (storage == k::Storage::Int8 ? "int8" : "fp16") << " R=" << rerank << " recall@10 " << found << std::endl;
+            check(found >= (rerank == k ? 0.9 : 0.99), "quantized recall");
+        }
+    }
+}
+void testHamming() {
+    const size_t count = 3000, words = 4, k = 10, queryCount = 20;
+    std::mt19937_64 random(6);
+    std::vector<uint64_t> codes(count * words), queries(queryCount * words);
+    for (auto& word : codes) {
+        word = random();
+    }
+    for (auto& word : queries) {
+        word = random();
+    }
+    auto distance = [&](const uint64_t* query, size_t row) {
+        uint32_t bits = 0;
+        for (size_t w = 0; w < words; ++w) {
+            bits += static_cast<uint32_t>(std::popcount(query[w] ^ codes[row * words + w]));
+        }
+        return bits;
+    };
+    k::Hamming index(codes.data(), count, words);
+    auto results = index.searchBatch(queries.data(), queryCount, k);
+    bool exact = true;
+    for (size_t q = 0; q < queryCount; ++q) {
+        const uint64_t* query = queries.data() + q * words;
+        // brute force : every distance, sorted (ties may pick other rows, so the distances are compared)
+        std::vector<uint32_t> truth;
+        for (size_t row = 0; row < count; ++row) {
+            truth.push_back(distance(query, row));
+        }
+        std::sort(truth.begin(), truth.end());
+        std::vector<k::Hamming::Neighbor> neighbors;
+        index.search(std::back_inserter(neighbors), query, k);
+        exact = exact && neighbors.size() == k && neighbors == results[q];
+        for (size_t i = 0; i < neighbors.size(); ++i) {
+            exact = exact && neighbors[i].second == truth[i] && neighbors[i].second == distance(query, neighbors[i].first);
+        }
+    }
+    std::cout << "hamming " << queryCount << " queries x " << count << " codes of " << words * 64 << " bits "
+              << (exact ? "match brute force" : "differ from brute force") << std::endl;
+    check(exact, "hamming exact");
+}
+void testFilter() {
+    const size_t count = 4000, dim = 32, k = 10;
+    auto [base, queries] = clusteredSplit(count, 50, dim, 7);
+    k::Nearest exact(base.data(), count, dim);
+    k::Hnsw hnsw(base.data(), count, dim, k::Metric::L2);
+    hnsw.build();
+    k::IvfOptions ivfOptions;
+    ivfOptions.lists = 64;
+    k::Ivf ivf(base.data(), count, dim, k::Metric::L2, ivfOptions);
+    ivf.build();
+    k::QuantizedNearest int8(base.data(), count, dim, k::Storage::Int8);
+    k::PqOptions pqOptions;
+    pqOptions.subspaces = 16;
+    k::Pq pq(base.data(), count, dim, pqOptions);
+    pq.build();
+
+    // every 3rd, 10th then 100th row (hashed) : list probing past nprobe, and the exact scans IVF / HNSW fall back to
+    for (size_t every : {3, 10, 100}) {
+        std::vector<uint64_t> allowed(k::Filter::words(count), 0);
+        for (size_t row = 0; row < count; ++row) {
+            if ((row * 2654435761u) % every == 0) {
+                k::Filter::set(allowed, row);
+            }
+        }
+        const k::Filter filter(allowed);
+
+        // k::Nearest must equal a brute force scan of the allowed rows
+        bool same = true;
+        for (size_t q = 0; q < queries.size() / dim; ++q) {
+            const float* query = queries.data() + q * dim;
+            std::vector<k::Nearest::Neighbor> neighbors, truth;
+            exact.search(std::back_inserter(neighbors), query, k, filter);
+            filter.forEach(count, [&](size_t row) { truth.emplace_back(row, k::simd::squaredL2(query, base.data() + row * dim, dim)); });
+            std::sort(truth.begin(), truth.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+            for (size_t i = 0; i < k; ++i) {
+                same = same && i < neighbors.size() && neighbors[i].first == truth[i].first;
+            }
+        }
+        check(same, "filtered exact search");
+
+        auto verify = [&](const std::string& name, double minimum, auto search) {
+            bool inside = true;
+            double found = recall(exact, queries, k, [&](std::vector<k::Nearest::Neighbor>& neighbors, const float* query) {
+                search(neighbors, query);
+                for (auto [index, distance] : neighbors) {
+                    inside = inside && filter.allows(index);
+                }
+            }, filter);
+            std::cout << name << " allowing " << filter.count(count) << " of " << count << " rows recall@10 " << found
+                      << (inside ? "" : " (returned rows outside the filter!)") << std::endl;
+            check(inside, name + " filter");
+            check(found >= minimum, name + " filtered recall");
+        };
+        verify("hnsw", 0.9, [&](auto& neighbors, const float* query) { hnsw.search(std::back_inserter(neighbors), query, k, 0, filter); });
+        verify("ivf", 0.9, [&](auto& neighbors, const float* query) { ivf.search(std::back_inserter(neighbors), query, k, 0, filter); });
+        auto batch = ivf.searchBatch(queries.data(), queries.size() / dim, k, 0, 0, filter);
+        bool batchSame = true;
+        for (size_t q = 0; q < batch.size(); ++q) {
+            std::vector<k::Ivf::Neighbor> neighbors;
+            ivf.search(std::back_inserter(neighbors), queries.data() + q * dim, k, 0, filter);
+            batchSame = batchSame && batch[q] == neighbors;
+        }
+        check(batchSame, "ivf filtered batch");
+        verify("int8", 0.99, [&](auto& neighbors, const float* query) { int8.search(std::back_inserter(neighbors), query, k, 0, filter); });
+        verify("pq", 0.9, [&](auto& neighbors, const float* query) { pq.search(std::back_inserter(neighbors), query, k, 0, filter); });
+    }
+}
+void testDataset() {
+    const size_t count = 3000, dim = 24, k = 10;
+    auto [rows, queries] = clusteredSplit(count, 20, dim, 8);
+    char path[] = "/tmp/select_k_dataset_XXXXXX";
+    int fd = ::mkstemp(path);
+    if (fd < 0) {
+        std::cout << "could not create temp file!" << std::endl;
+        return;
+    }
+    ::close(fd);
+    for (k::Dtype dtype : {k::Dtype::Float32, k::Dtype::Float16}) {
+        {
+            k::DatasetWriter writer(path, dim, dtype, k::kDatasetNorms | k::kDatasetIds);
+            for (size_t i = 0; i < count; ++i) {
+                writer.append(rows.data() + i * dim, 1000000 + i);
+            }
+            writer.finish();
+        }
+        k::Dataset dataset(path);
+        bool ok = dataset.count() == count && dataset.dim() == dim && dataset.id(7) == 1000007;
+        if (dtype == k::Dtype::Float32) {
+            // searching the mapped rows (with their stored norms) answers like searching the rows in memory
+            k::Nearest mapped(dataset.vectors(), dataset.count(), dataset.dim(), k::Metric::Cosine, false, dataset.norms());
+            k::Nearest memory(rows.data(), count, dim, k::Metric::Cosine);
+            for (size_t q = 0; q < queries.size() / dim; ++q) {
+                std::vector<k::Nearest::Neighbor> a, b;
+                mapped.search(std::back_inserter(a), queries.data() + q * dim, k);
+                memory.search(std::back_inserter(b), queries.data() + q * dim, k);
+                for (size_t i = 0; i < k; ++i) {
+                    ok = ok && a[i].first == b[i].first && std::fabs(a[i].second - b[i].second) < 1e-5f;
+                }
+            }
+        } else {
+            // fp16 rows come back within half precision (11 significant bits)
+            std::vector<float> restored(count * dim);
+            k::simd::toFloat(dataset.halves(), restored.data(), count * dim);
+            for (size_t i = 0; i < count * dim; ++i) {
+                ok = ok && std::fabs(restored[i] - rows[i]) <= std::fabs(rows[i]) / 1024 + 1e-4f;
+            }
+        }
+        std::cout << (dtype == k::Dtype::Float32 ? "fp32" : "fp16") << " dataset of " << dataset.count() << " x "
+                  << dataset.dim() << (ok ? " round trips" : " does not round trip") << std::endl;
+        check(ok, "dataset round trip");
+    }
+    // a file that is not a dataset is rejected
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << std::string(8192, 'x');
+    }
+    bool rejected = false;
+    try {
+        k::Dataset dataset(path);
+    } catch (const std::system_error&) {
+        rejected = true;
+    }
+    check(rejected, "dataset header check");
+    ::unlink(path);
+}
+void testJoin() {
+    // not a multiple of AllNearest::kBlock, so the last block is partial
+    const size_t count = 1500, dim = 16, k = 8;
+    std::vector<float> rows = clusteredRows(count, dim, 9);
+    for (k::Metric metric : {k::Metric::L2, k::Metric::InnerProduct, k::Metric::Cosine}) {
+        auto graph = k::AllNearest::compute(rows.data(), count, dim, k, metric);
+        // each row's list must be its K + 1 nearest by search(), minus the row itself
+        k::Nearest nearest(rows.data(), count, dim, metric);
+        bool same = graph.size() == count;
+        for (size_t i = 0; same && i < count; ++i) {
+            std::vector<k::Nearest::Neighbor> neighbors;
+            nearest.search(std::back_inserter(neighbors), rows.data() + i * dim, k + 1);
+            std::erase_if(neighbors, [i](const k::Nearest::Neighbor& neighbor) { return neighbor.first == i; });
+            neighbors.resize(k);
+            same = graph[i].size() == k;
+            for (size_t j = 0; same && j < k; ++j) {
+                same = graph[i][j].first == neighbors[j].first;
+            }
+        }
+        const char* name = metric == k::Metric::L2 ? "l2" : (metric == k::Metric::Cosine ? "cosine" : "inner product");
+        std::cout << "all-" << k << "-nn join of " << count << " rows (" << name << ") "
+                  << (same ? "matches" : "differs from") << " per row search" << std::endl;
+        check(same, "all-knn join");
+    }
+}
+void testNnDescent() {
+    const size_t count = 4000, dim = 32, k = 10;
+    auto [base, queries] = clusteredSplit(count, 50, dim, 10);
+    k::NnDescent index(base.data(), count, dim, k);
+    index.build();
+
+    // graph recall : the share of the exact join's lists the descent found
+    auto exactGraph = k::AllNearest::compute(base.data(), count, dim, k);
+    auto graph = index.graph();
+    size_t found = 0;
+    for (size_t i = 0; i < count; ++i) {
+        std::set<size_t> rows;
+        for (auto [row, distance] : exactGraph[i]) {
+            rows.insert(row);
+        }
+        for (auto [row, distance] : graph[i]) {
+            found += rows.count(row);
+        }
+    }
+    const double graphRecall = double(found) / double(count * k);
+    std::cout << "nn-descent graph recall " << graphRecall << " after " << index.updates().size() << " iterations" << std::endl;
+    check(graphRecall >= 0.95, "nn-descent graph recall");
+
+    k::Nearest exact(base.data(), count, dim);
+    double searchRecall = recall(exact, queries, k, [&index](std::vector<k::NnDescent::Neighbor>& neighbors, const float* query) {
+        index.search(std::back_inserter(neighbors), query, 10);
+    });
+    std::cout << "nn-descent search recall@10 " << searchRecall << std::endl;
+    check(searchRecall >= 0.9, "nn-descent search recall");
+
+    // a 1% allow-list is answered by an exact scan of the allowed rows
+    std::vector<uint64_t> allowed(k::Filter::words(count), 0);
+    for (size_t row = 0; row < count; row += 100) {
+        k::Filter::set(allowed, row);
+    }
+    const k::Filter filter(allowed);
+    double filteredRecall = recall(exact, queries, k, [&](std::vector<k::NnDescent::Neighbor>& neighbors, const float* query) {
+        index.search(std::back_inserter(neighbors), query, 10, 0, filter);
+    }, filter);
+    std::cout << "nn-descent allowing " << filter.count(count) << " rows recall@10 " << filteredRecall << std::endl;
+    check(filteredRecall == 1.0, "nn-descent filtered search");
+}
+void testExternal() {
+    // distinct scores (an odd multiplier permutes uint32), so the best K has one order
+    const uint32_t count = 200000;
+    const size_t k = 5000;
+    auto score = [](const uint32_t& v) { return static_cast<uint64_t>(v * 2654435761u); };
+    auto source = [count](auto&& emit) {
+        for (uint32_t v = 0; v < count; ++v) {
+            emit(v);
+        }
+    };
+    std::vector<uint32_t> expected;
+    k::Top<uint32_t, uint64_t> top(k, score);
+    source([&top](const uint32_t& v) { top.offer(v); });
+    top.results(std::back_inserter(expected), true, false);
+
+    // memory for well under K records : the survivors are sorted in runs and merged 4 at a time over several
+    // passes; a small sample with a negative margin also cuts too tight at first, so the partition pass is repeated
+    k::ExternalOptions spills;
+    spills.memoryBytes = 1000 * (sizeof(uint32_t) + sizeof(uint64_t));
+    spills.maxFanIn = 4;
+    k::ExternalOptions retries = spills;
+    retries.sampleSize = 64;
+    retries.margin = -2;
+    for (const k::ExternalOptions& options : {spills, retries}) {
+        std::vector<uint32_t> results;
+        k::ExternalTop<uint32_t, uint64_t>::compute([&results](const uint32_t& v, uint64_t) { results.push_back(v); },
+                                                    k, source, score, options);
+        std::cout << "external top " << k << " of " << count << " with " << options.memoryBytes << " bytes (sample "
+                  << options.sampleSize << ") " << (results == expected ? "matches" : "differs from") << " k::Top" << std::endl;
+        check(results == expected, "external select");
+    }
+}
+void testKdCursor() {
+    const size_t count = 2000, dim = 3, total = 240;
+    std::vector<float> points = clusteredRows(count, dim, 11);
+    k::KdTree<float> tree(points.data(), count, dim);
+    const float* query = points.data() + 17 * dim;
+    // whatever the page size, the pages so far must be search() with their cumulative K
+    for (size_t page : {1, 7, 64}) {
+        auto cursor = tree.nearest(query);
+        std::vector<k::KdTree<float>::Neighbor> paged;
+        bool same = true;
+        while (same && paged.size() < total) {
+            cursor.next(std::back_inserter(paged), page);
+            std::vector<k::KdTree<float>::Neighbor> searched;
+            tree.search(std::back_inserter(searched), query, paged.size());
+            same = paged == searched;
+        }
+        std::cout << "kd-tree cursor pages of " << page << (same ? " match" : " differ from") << " search() up to K="
+                  << paged.size() << std::endl;
+        check(same, "kd-tree cursor paging");
+    }
+    // the cursor runs out after every point, having visited all of them nearest first
+    std::vector<float> distances(count);
+    for (size_t i = 0; i < count; ++i) {
+        distances[i] = k::simd::squaredL2(query, points.data() + i * dim, dim);
+    }
+    auto cursor = tree.nearest(query);
+    std::vector<k::KdTree<float>::Neighbor> all;
+    cursor.next(std::back_inserter(all), count + 10);
+    k::KdTree<float>::Neighbor neighbor;
+    check(all.size() == count && !cursor.next(neighbor), "kd-tree cursor end");
+    check(bruteForce(all, distances, count, true, 1e-5), "kd-tree cursor brute force");
+
+    // search() against brute force from several queries, built with 1 and 4 threads, K up to past the point count
+    for (size_t threads : {1, 4}) {
+        k::KdTree<float> built(points.data(), count, dim, threads);
+        bool same = true;
+        for (size_t q = 0; q < 20; ++q) {
+            const float* at = points.data() + (q * 97) % count * dim;
+            for (size_t i = 0; i < count; ++i) {
+                distances[i] = k::simd::squaredL2(at, points.data() + i * dim, dim);
+            }
+            for (size_t k : {size_t(1), size_t(16), count + 5}) {
+                std::vector<k::KdTree<float>::Neighbor> neighbors;
+                built.search(std::back_inserter(neighbors), at, k);
+                same = same && bruteForce(neighbors, distances, k, true, 1e-5);
+            }
+        }
+        check(same, "kd-tree brute force with " + std::to_string(threads) + " build threads");
+    }
 }
 int main(int argc, char** argv) {
     std::cout << "**** TESTING INTS ... " << std::endl;
@@ -123,6 +1071,57 @@ int main(int argc, char** argv) {
 
     std::cout << "**** TESTING POINTS ..." << std::endl;
     testPoints();
-    
-    return 0;
+
+    std::cout << "**** TESTING KD-TREE CURSOR ..." << std::endl;
+    testKdCursor();
+
+    std::cout << "**** TESTING CHECKPOINT/RESTORE ..." << std::endl;
+    testCheckpoint();
+
+    std::cout << "**** TESTING MAPPED RECORDS ..." << std::endl;
+    testRecords();
+
+    std::cout << "**** TESTING FORK / MERGE ..." << std::endl;
+    testForkMerge();
+
+    std::cout << "**** TESTING COLUMNAR TOP-K ..." << std::endl;
+    testColumnar();
+
+    std::cout << "**** TESTING DENSE VECTOR NEAREST ..." << std::endl;
+    testNearest();
+
+    std::cout << "**** TESTING VP-TREE ..." << std::endl;
+    testVpTree();
+
+    std::cout << "**** TESTING PRODUCT QUANTIZATION ..." << std::endl;
+    testPq();
+
+    std::cout << "**** TESTING HNSW ..." << std::endl;
+    testHnsw();
+
+    std::cout << "**** TESTING IVF ..." << std::endl;
+    testIvf();
+
+    std::cout << "**** TESTING INT8 / FP16 SCANS ..." << std::endl;
+    testQuantized();
+
+    std::cout << "**** TESTING HAMMING CODES ..." << std::endl;
+    testHamming();
+
+    std::cout << "**** TESTING FILTERED SEARCH ..." << std::endl;
+    testFilter();
+
+    std::cout << "**** TESTING VECTOR DATASETS ..." << std::endl;
+    testDataset();
+
+    std::cout << "**** TESTING ALL-K-NN JOIN ..." << std::endl;
+    testJoin();
+
+    std::cout << "**** TESTING NN-DESCENT ..." << std::endl;
+    testNnDescent();
+
+    std::cout << "**** TESTING EXTERNAL SELECT ..." << std::endl;
+    testExternal();
+
+    return failures == 0 ? 0 : 1;
 }
\ No newline at end of file
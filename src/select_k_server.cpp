@@ -0,0 +1,518 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  select_k_server : shared top-k / bottom-k leaderboards over Unix / TCP sockets (Linux, epoll)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ *  $ select_k_server --unix /tmp/select_k.sock --tcp 127.0.0.1:7070
+ *
+ *  Wire format (all integers little endian) - every frame is  u32 body length | u8 type | body
+ *
+ *  requests
+ *      CREATE (1)  u8 order (0 = top, 1 = bottom) | u32 k | u16 name length | name      -> OK / ERROR
+ *      OFFER  (2)  u16 name length | name | u32 count | count x entry                   -> nothing / ERROR
+ *      QUERY  (3)  u16 name length | name | u32 limit (0 = all)                          -> RESULTS / ERROR
+ *      DROP   (4)  u16 name length | name                                                -> OK / ERROR
+ *  responses
+ *      OK      (0x80)  empty
+ *      ERROR   (0x81)  u16 message length | message
+ *      RESULTS (0x83)  u32 count | count x entry (best first)
+ *  entry
+ *      f64 score | u16 key length | key | u32 payload length | payload
+ *
+ *  OFFER is not acknowledged so clients can pipeline batches. Frames are decoded in batches straight out of the
+ *  connection buffer and an entry is only copied if its score makes it into the selection. A malformed frame
+ *  closes the connection. CREATE on an existing name with the same order and k is a no-op. An error message longer
+ *  than its u16 length is truncated. A connection holds at most one frame of unread input; one whose unsent replies
+ *  pass kMaxOutput (a peer that stopped reading) is closed.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+#include "select_k/select_k.h"
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <limits>
+#include <variant>
+#include <memory>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+namespace {
+
+enum FrameType : uint8_t {
+    kCreate = 1,
+    kOffer = 2,
+    kQuery = 3,
+    kDrop = 4,
+    kOk = 0x80,
+    kError = 0x81,
+    kResults = 0x83,
+};
+
+// a frame body larger than this closes the connection
+constexpr uint32_t kMaxFrame = 64 << 20;
+// unsent reply bytes past this close the connection
+constexpr size_t kMaxOutput = size_t(256) << 20;
+
+struct Entry {
+    std::string key;
+    std::string payload;
+};
+
+using TopBoard = k::Top<Entry, double>;
+using BottomBoard = k::Bottom<Entry, double>;
+using Board = std::variant<TopBoard, BottomBoard>;
+
+// bounds checked little endian reader over a frame body
+class Reader {
+public:
+    Reader(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+    template <typename Number>
+    bool number(Number& value) {
+        if (static_cast<size_t>(end_ - p_) < sizeof(Number)) { return false; }
+        std::memcpy(&value, p_, sizeof(Number));
+        p_ += sizeof(Number);
+        return true;
+    }
+
+    template <typename Length>
+    bool bytes(std::string_view& value) {
+        Length length;
+        if (!number(length) || static_cast<size_t>(end_ - p_) < length) { return false; }
+        value = std::string_view(p_, length);
+        p_ += length;
+        return true;
+    }
+
+    bool done() const { return p_ == end_; }
+private:
+    const char* p_;
+    const char* end_;
+};
+
+class Writer {
+public:
+    explicit Writer(std::string& out) : out_(out) {}
+
+    template <typename Number>
+    void number(Number value) {
+        out_.append(reinterpret_cast<const char*>(&value), sizeof(Number));
+    }
+
+    // value prefixed with its Length, cut to the longest prefix the Length can describe
+    template <typename Length>
+    void bytes(std::string_view value) {
+        value = value.substr(0, std::min<size_t>(value.size(), std::numeric_limits<Length>::max()));
+        number(static_cast<Length>(value.size()));
+        out_.append(value);
+    }
+private:
+    std::string& out_;
+};
+
+struct Connection {
+    int fd;
+    std::string in;
+    std::string out;
+    size_t inOffset = 0;
+};
+
+volatile std::sig_atomic_t stopping = 0;
+
+void onSignal(int) {
+    stopping = 1;
+}
+
+class Server {
+public:
+    ~Server() {
+        for (auto& [fd, connection] : connections_) {
+            ::close(fd);
+        }
+        for (int fd : listeners_) {
+            ::close(fd);
+        }
+        if (epoll_ >= 0) { ::close(epoll_); }
+        if (!unixPath_.empty()) { ::unlink(unixPath_.c_str()); }
+    }
+
+    bool init() {
+        epoll_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_ < 0) {
+            std::perror("epoll_create1");
+            return false;
+        }
+        return true;
+    }
+
+    bool listenUnix(const std::string& path) {
+        sockaddr_un address {};
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "select_k_server: unix socket path too long: " << path << std::endl;
+            return false;
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        ::unlink(path.c_str());
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+            std::perror(("listen " + path).c_str());
+            if (fd >= 0) { ::close(fd); }
+            return false;
+        }
+        unixPath_ = path;
+        return addListener(fd);
+    }
+
+    bool listenTcp(const std::string& hostPort) {
+        auto colon = hostPort.rfind(':');
+        std::string host = colon == std::string::npos ? "127.0.0.1" : hostPort.substr(0, colon);
+        std::string port = colon == std::string::npos ? hostPort : hostPort.substr(colon + 1);
+        addrinfo hints {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* result = nullptr;
+        if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 || result == nullptr) {
+            std::cerr << "select_k_server: cannot resolve " << hostPort << std::endl;
+            return false;
+        }
+        int fd = ::socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int on = 1;
+        bool ok = fd >= 0
+            && ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == 0
+            && ::bind(fd, result->ai_addr, result->ai_addrlen) == 0
+            && ::listen(fd, SOMAXCONN) == 0;
+        ::freeaddrinfo(result);
+        if (!ok) {
+            std::perror(("listen " + hostPort).c_str());
+            if (fd >= 0) { ::close(fd); }
+            return false;
+        }
+        return addListener(fd);
+    }
+
+    void run() {
+        std::vector<epoll_event> events(256);
+        while (!stopping) {
+            int ready = ::epoll_wait(epoll_, events.data(), static_cast<int>(events.size()), -1);
+            if (ready < 0) {
+                if (errno == EINTR) { continue; }
+                std::perror("epoll_wait");
+                return;
+            }
+            for (int i = 0; i < ready; ++i) {
+                int fd = events[i].data.fd;
+                if (isListener(fd)) {
+                    accept(fd);
+                    continue;
+                }
+                auto found = connections_.find(fd);
+                if (found == connections_.end()) { continue; }
+                Connection& connection = *found->second;
+                bool open = true;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    open = receive(connection);
+                }
+                if (open && (events[i].events & EPOLLOUT)) {
+                    open = flush(connection);
+                }
+                if (!open) {
+                    close(fd);
+                }
+            }
+        }
+    }
+
+private:
+    bool addListener(int fd) {
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (::epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            std::perror("epoll_ctl");
+            ::close(fd);
+            return false;
+        }
+        listeners_.push_back(fd);
+        return true;
+    }
+
+    bool isListener(int fd) const {
+        for (int listener : listeners_) {
+            if (listener == fd) { return true; }
+        }
+        return false;
+    }
+
+    void accept(int listener) {
+        for (;;) {
+            int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) { return; }
+            int on = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            epoll_event event {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (::epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) != 0) {
+                ::close(fd);
+                continue;
+            }
+            auto connection = std::make_unique<Connection>();
+            connection->fd = fd;
+            connections_.emplace(fd, std::move(connection));
+        }
+    }
+
+    void close(int fd) {
+        ::epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections_.erase(fd);
+    }
+
+    // reads everything available and decodes all complete frames, returns false if the connection is to be closed
+    bool receive(Connection& connection) {
+        char chunk[1 << 16];
+        bool open = true;
+        // read no more than one whole frame ahead, the rest stays in the socket until these frames are decoded
+        while (connection.in.size() < 5 + size_t(kMaxFrame)) {
+            ssize_t n = ::recv(connection.fd, chunk, sizeof(chunk), 0);
+            if (n > 0) {
+                connection.in.append(chunk, static_cast<size_t>(n));
+                if (static_cast<size_t>(n) < sizeof(chunk)) { break; }
+                continue;
+            }
+            if (n < 0 && errno == EINTR) { continue; }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) { break; }
+            open = false;
+            break;
+        }
+        while (connection.in.size() - connection.inOffset >= 5) {
+            const char* frame = connection.in.data() + connection.inOffset;
+            uint32_t length;
+            std::memcpy(&length, frame, sizeof(length));
+            if (length > kMaxFrame) { return false; }
+            if (connection.in.size() - connection.inOffset < 5 + size_t(length)) { break; }
+            if (!dispatch(connection, static_cast<uint8_t>(frame[4]), frame + 5, length)) { return false; }
+            connection.inOffset += 5 + size_t(length);
+            if (connection.out.size() > kMaxOutput) { return false; }
+        }
+        connection.in.erase(0, connection.inOffset);
+        connection.inOffset = 0;
+        return flush(connection) && open;
+    }
+
+    bool flush(Connection& connection) {
+        size_t sent = 0;
+        while (sent < connection.out.size()) {
+            ssize_t n = ::send(connection.fd, connection.out.data() + sent, connection.out.size() - sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) { continue; }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) { break; }
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        connection.out.erase(0, sent);
+        epoll_event event {};
+        event.events = connection.out.empty() ? EPOLLIN : (EPOLLIN | EPOLLOUT);
+        event.data.fd = connection.fd;
+        ::epoll_ctl(epoll_, EPOLL_CTL_MOD, connection.fd, &event);
+        return true;
+    }
+
+    // handles one frame, returns false if the frame is malformed
+    bool dispatch(Connection& connection, uint8_t type, const char* body, uint32_t length) {
+        Reader reader(body, length);
+        std::string_view name;
+        switch (type) {
+        case kCreate: {
+            uint8_t order;
+            uint32_t k;
+            if (!reader.number(order) || !reader.number(k) || !reader.bytes<uint16_t>(name) || !reader.done() || order > 1) {
+                return false;
+            }
+            create(connection, std::string(name), order == 0, k);
+            return true;
+        }
+        case kOffer: {
+            uint32_t count;
+            if (!reader.bytes<uint16_t>(name) || !reader.number(count)) { return false; }
+            auto board = boards_.find(std::string(name));
+            Board* target = board == boards_.end() ? nullptr : &board->second;
+            for (uint32_t i = 0; i < count; ++i) {
+                double score;
+                std::string_view key, payload;
+                if (!reader.number(score) || !reader.bytes<uint16_t>(key) || !reader.bytes<uint32_t>(payload)) {
+                    return false;
+                }
+                if (target != nullptr && score == score) {
+                    std::visit([&](auto& selector) {
+                        if (selector.admits(score)) {
+                            selector.offerScored(Entry { std::string(key), std::string(payload) }, score);
+                        }
+                    }, *target);
+                }
+            }
+            if (!reader.done()) { return false; }
+            if (target == nullptr) {
+                error(connection, "no such selector: " + std::string(name));
+            }
+            return true;
+        }
+        case kQuery: {
+            uint32_t limit;
+            if (!reader.bytes<uint16_t>(name) || !reader.number(limit) || !reader.done()) { return false; }
+            auto board = boards_.find(std::string(name));
+            if (board == boards_.end()) {
+                error(connection, "no such selector: " + std::string(name));
+                return true;
+            }
+            std::vector<std::pair<Entry, double>> entries;
+            std::visit([&](const auto& selector) {
+                selector.scoredResults(std::back_inserter(entries), true);
+            }, board->second);
+            if (limit != 0 && entries.size() > limit) {
+                entries.resize(limit);
+            }
+            std::string body;
+            Writer writer(body);
+            writer.number(static_cast<uint32_t>(entries.size()));
+            for (const auto& [entry, score] : entries) {
+                writer.number(score);
+                writer.bytes<uint16_t>(entry.key);
+                writer.bytes<uint32_t>(entry.payload);
+            }
+            respond(connection, kResults, body);
+            return true;
+        }
+        case kDrop: {
+            if (!reader.bytes<uint16_t>(name) || !reader.done()) { return false; }
+            if (boards_.erase(std::string(name)) == 0) {
+                error(connection, "no such selector: " + std::string(name));
+            } else {
+                respond(connection, kOk, {});
+            }
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    void create(Connection& connection, const std::string& name, bool top, uint32_t k) {
+        auto existing = boards_.find(name);
+        if (existing != boards_.end()) {
+            bool same = existing->second.index() == (top ? 0u : 1u)
+                && std::visit([k](const auto& selector) { return selector.k() == k; }, existing->second);
+            if (same) {
+                respond(connection, kOk, {});
+            } else {
+                error(connection, "selector exists with a different order or k: " + name);
+            }
+            return;
+        }
+        auto scorer = [](const Entry&) { return 0.0; };  // entries always arrive scored
+        if (top) {
+            boards_.emplace(name, Board(std::in_place_type<TopBoard>, k, scorer));
+        } else {
+            boards_.emplace(name, Board(std::in_place_type<BottomBoard>, k, scorer));
+        }
+        respond(connection, kOk, {});
+    }
+
+    void respond(Connection& connection, uint8_t type, std::string_view body) {
+        Writer writer(connection.out);
+        writer.number(static_cast<uint32_t>(body.size()));
+        writer.number(type);
+        connection.out.append(body);
+    }
+
+    void error(Connection& connection, const std::string& message) {
+        std::string body;
+        Writer(body).bytes<uint16_t>(message);
+        respond(connection, kError, body);
+    }
+
+    int epoll_ = -1;
+    std::vector<int> listeners_;
+    std::string unixPath_;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    std::unordered_map<std::string, Board> boards_;
+};
+
+void usage(const char* program) {
+    std::cerr << "usage: " << program << " [--unix PATH] [--tcp [HOST:]PORT]" << std::endl
+              << "Serves named top-k / bottom-k selectors (see src/select_k_server.cpp for the wire format)" << std::endl
+              << "  -u, --unix PATH          listen on a unix domain socket" << std::endl
+              << "  -t, --tcp [HOST:]PORT    listen on TCP (HOST defaults to 127.0.0.1)" << std::endl
+              << "  -h, --help               this message" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    static const option longOptions[] = {
+        { "unix", required_argument, nullptr, 'u' },
+        { "tcp", required_argument, nullptr, 't' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 },
+    };
+    std::vector<std::string> unixPaths, tcpAddresses;
+    int c;
+    while ((c = getopt_long(argc, argv, "u:t:h", longOptions, nullptr)) != -1) {
+        switch (c) {
+        case 'u': unixPaths.push_back(optarg); break;
+        case 't': tcpAddresses.push_back(optarg); break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if ((unixPaths.empty() && tcpAddresses.empty()) || unixPaths.size() > 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    Server server;
+    if (!server.init()) { return 1; }
+    for (const auto& path : unixPaths) {
+        if (!server.listenUnix(path)) { return 1; }
+    }
+    for (const auto& address : tcpAddresses) {
+        if (!server.listenTcp(address)) { return 1; }
+    }
+    server.run();
+    return 0;
+}
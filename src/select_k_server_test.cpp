@@ -0,0 +1,249 @@
+/**
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributor(s): Saurav Mohapatra (mohaps@gmail.com)
+ *
+ *
+ * ----------------------------------------------------------------------------------------------------------------
+ *  select_k_server_test : wire protocol round trips against a running select_k_server (Linux)
+ * ----------------------------------------------------------------------------------------------------------------
+ *
+ *  $ select_k_server_test [path to select_k_server]       # default bin/select_k_server
+ *
+ *  Starts the server on a Unix socket in a temporary directory, talks to it with the frames documented at the top of
+ *  src/select_k_server.cpp and compares every reply with the expected one (results with a local k::Top). Exits non
+ *  zero if a check fails. make server-test builds both and runs it.
+ * ---------------------------------------------------------------------------------------------------------------
+ *
+ */
+#include "select_k/select_k.h"
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "  ok  " : "  !!  ") << what << std::endl;
+    if (!ok) { ++failures; }
+}
+
+// frame body builder (little endian, as the server writes)
+class Body {
+public:
+    template <typename Number>
+    Body& number(Number value) {
+        bytes_.append(reinterpret_cast<const char*>(&value), sizeof(Number));
+        return *this;
+    }
+    template <typename Length>
+    Body& bytes(std::string_view value) {
+        number(static_cast<Length>(value.size()));
+        bytes_.append(value);
+        return *this;
+    }
+    const std::string& str() const { return bytes_; }
+private:
+    std::string bytes_;
+};
+
+// bounds checked reader over a reply body
+class Parser {
+public:
+    explicit Parser(std::string_view body) : body_(body) {}
+    template <typename Number>
+    bool number(Number& value) {
+        if (body_.size() < sizeof(Number)) { return false; }
+        std::memcpy(&value, body_.data(), sizeof(Number));
+        body_.remove_prefix(sizeof(Number));
+        return true;
+    }
+    template <typename Length>
+    bool bytes(std::string& value) {
+        Length length;
+        if (!number(length) || body_.size() < length) { return false; }
+        value.assign(body_.data(), length);
+        body_.remove_prefix(length);
+        return true;
+    }
+    bool done() const { return body_.empty(); }
+private:
+    std::string_view body_;
+};
+
+class Client {
+public:
+    explicit Client(const std::string& path) {
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        // the server may still be starting up
+        for (int attempt = 0; attempt < 200 && fd_ < 0; ++attempt) {
+            int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+                fd_ = fd;
+            } else {
+                ::close(fd);
+                ::usleep(10000);
+            }
+        }
+    }
+    ~Client() {
+        if (fd_ >= 0) { ::close(fd_); }
+    }
+    bool connected() const { return fd_ >= 0; }
+
+    bool send(uint8_t type, const std::string& body) {
+        std::string frame;
+        uint32_t length = static_cast<uint32_t>(body.size());
+        frame.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        frame.push_back(static_cast<char>(type));
+        frame.append(body);
+        return all(frame.data(), frame.size(), true);
+    }
+
+    // next reply frame, false once the server closed the connection
+    bool receive(uint8_t& type, std::string& body) {
+        char header[5] = {};
+        uint32_t length = 0;
+        if (!all(header, sizeof(header), false)) { return false; }
+        std::memcpy(&length, header, sizeof(length));
+        type = static_cast<uint8_t>(header[4]);
+        body.resize(length);
+        return all(body.data(), length, false);
+    }
+private:
+    bool all(const char* data, size_t size, bool write) {
+        while (size > 0) {
+            ssize_t n = write ? ::send(fd_, data, size, MSG_NOSIGNAL) : ::recv(fd_, const_cast<char*>(data), size, 0);
+            if (n < 0 && errno == EINTR) { continue; }
+            if (n <= 0) { return false; }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+    int fd_ = -1;
+};
+
+constexpr uint8_t kCreate = 1, kOffer = 2, kQuery = 3, kDrop = 4, kOk = 0x80, kError = 0x81, kResults = 0x83;
+
+bool expect(Client& client, uint8_t wanted, std::string* body = nullptr) {
+    uint8_t type = 0;
+    std::string reply;
+    if (!client.receive(type, reply) || type != wanted) { return false; }
+    if (body != nullptr) { *body = reply; }
+    return true;
+}
+
+void testProtocol(const std::string& path) {
+    Client client(path);
+    check(client.connected(), "connect");
+    if (!client.connected()) { return; }
+
+    client.send(kCreate, Body().number<uint8_t>(0).number<uint32_t>(3).bytes<uint16_t>("scores").str());
+    check(expect(client, kOk), "CREATE top 3");
+    client.send(kCreate, Body().number<uint8_t>(1).number<uint32_t>(3).bytes<uint16_t>("scores").str());
+    check(expect(client, kError), "CREATE with another order is an error");
+
+    // two pipelined OFFER batches, then QUERY against a local k::Top
+    using Scored = std::pair<std::string, double>;
+    k::Top<std::string, double> expected(3, [](const std::string&) { return 0.0; });
+    for (int batch = 0; batch < 2; ++batch) {
+        Body body;
+        body.bytes<uint16_t>("scores").number<uint32_t>(50);
+        for (int i = 0; i < 50; ++i) {
+            const int value = batch * 50 + i;
+            const double score = static_cast<double>((value * 37) % 101);
+            const std::string key = "key" + std::to_string(value);
+            body.number(score).bytes<uint16_t>(key).bytes<uint32_t>("payload of " + key);
+            expected.offerScored(key, score);
+        }
+        client.send(kOffer, body.str());
+    }
+    client.send(kQuery, Body().bytes<uint16_t>("scores").number<uint32_t>(0).str());
+    std::string reply;
+    bool results = expect(client, kResults, &reply);
+    std::vector<Scored> wanted, got;
+    expected.scoredResults(std::back_inserter(wanted), true);
+    Parser parser(reply);
+    uint32_t count = 0;
+    results = results && parser.number(count);
+    for (uint32_t i = 0; results && i < count; ++i) {
+        double score;
+        std::string key, payload;
+        results = parser.number(score) && parser.bytes<uint16_t>(key) && parser.bytes<uint32_t>(payload) &&
+                  payload == "payload of " + key;
+        got.emplace_back(key, score);
+    }
+    check(results && parser.done() && got == wanted, "OFFER x 2 batches + QUERY matches k::Top");
+
+    // an error naming a 65535 byte selector (the longest name) is cut to its u16 length, and the stream stays in sync
+    const std::string longName(65535, 'n');
+    client.send(kQuery, Body().bytes<uint16_t>(longName).number<uint32_t>(0).str());
+    std::string message;
+    bool errorOk = expect(client, kError, &reply);
+    Parser errorParser(reply);
+    errorOk = errorOk && errorParser.bytes<uint16_t>(message) && errorParser.done();
+    check(errorOk && message.size() == 65535 && message.compare(0, 18, "no such selector: ") == 0,
+          "long error message is truncated to 65535 bytes");
+    client.send(kQuery, Body().bytes<uint16_t>("scores").number<uint32_t>(1).str());
+    check(expect(client, kResults, &reply) && reply.size() > 4, "QUERY after a truncated error");
+
+    client.send(kDrop, Body().bytes<uint16_t>("scores").str());
+    check(expect(client, kOk), "DROP");
+    client.send(kQuery, Body().bytes<uint16_t>("scores").number<uint32_t>(0).str());
+    check(expect(client, kError), "QUERY after DROP is an error");
+
+    // a malformed frame closes the connection
+    client.send(99, "");
+    uint8_t type;
+    check(!client.receive(type, reply), "unknown frame type closes the connection");
+}
+
+}
+
+int main(int argc, char** argv) {
+    const std::string server = argc > 1 ? argv[1] : "bin/select_k_server";
+    char directory[] = "/tmp/select_k_server_XXXXXX";
+    if (::mkdtemp(directory) == nullptr) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    const std::string path = std::string(directory) + "/server.sock";
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        ::execl(server.c_str(), server.c_str(), "--unix", path.c_str(), static_cast<char*>(nullptr));
+        std::perror(("exec " + server).c_str());
+        ::_exit(127);
+    }
+    testProtocol(path);
+    ::kill(pid, SIGTERM);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ::unlink(path.c_str());
+    ::rmdir(directory);
+    std::cout << (failures == 0 ? "all server checks passed" : "server checks failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}